@@ -330,6 +330,27 @@ static bool set_kernel_args(cl_kernel kernel, Ts... args) {
     return (set_kernel_arg(kernel, index++, args) && ...);
 }
 
+// search strategies in sdf.cl, the first one is the default
+namespace engine {
+struct engine {
+    std::string_view name;
+    std::string_view search_function;
+    std::string_view description;
+};
+
+static constexpr engine engines[] = {
+    {"triangle", "search_triangle", "4-way symmetric triangle search, exits at the first ring containing a candidate"},
+    {"square", "search_square", "square search over the spread radius, shrinks the bounds as candidates are found"},
+};
+
+static const engine* from_str(std::string_view name) {
+    const auto find = std::find_if(std::begin(engines), std::end(engines), [&name](const auto& e) {
+        return e.name == name;
+    });
+    return find == std::end(engines) ? nullptr : find;
+}
+} // namespace engine
+
 void CL_CALLBACK kernel_callback(cl_event event, cl_int event_command_status, void* user_data) {
     (void)event_command_status;
     (void)user_data;
@@ -390,11 +411,16 @@ int main(int argc, char* argv[]) {
         .implicit_value(true);
 
     argparse.add_argument("-n", "--invert")
-        .help("Invert pixel value test. If set, values BELOW middle grey will be counted as \"inside\".")
+        .help("Invert pixel value test. If set, values BELOW the threshold will be counted as \"inside\".")
         .nargs(0)
         .default_value(false)
         .implicit_value(true);
 
+    argparse.add_argument("-t", "--threshold")
+        .help("Pixel values above this threshold (below if inverted) are counted as \"inside\".")
+        .default_value<int>(127)
+        .scan<'i', int>();
+
     argparse.add_argument("--list-platforms")
         .help("List all platforms on machine by name then exits.")
         .nargs(0)
@@ -417,6 +443,17 @@ int main(int argc, char* argv[]) {
         .help("Choose device by name. Use --list-devices to list the device for a platform. Chooses first device "
               "otherwise.");
 
+    argparse.add_argument("--engine")
+        .help("Search strategy used by the kernel. Use --list-engines to view the available ones.")
+        .nargs(1)
+        .default_value(std::string(engine::engines[0].name));
+
+    argparse.add_argument("--list-engines")
+        .help("List all search strategies then exits.")
+        .nargs(0)
+        .default_value(false)
+        .implicit_value(true);
+
     argparse.add_argument("--log-level")
         .help("Log level. Possible values: trace, debug, info, warning, error, critical, off.")
         .nargs(1)
@@ -449,6 +486,21 @@ int main(int argc, char* argv[]) {
                    [](unsigned char c) { return std::tolower(c); });
     spdlog::set_level(spdlog::level::from_str(log_level));
 
+    if (argparse["--list-engines"] == true) {
+        for (const auto& e : engine::engines) {
+            std::cout << e.name << '\t' << e.description << '\n';
+        }
+        return EXIT_SUCCESS;
+    }
+
+    const auto engine_name = argparse.get<std::string>("--engine");
+    const auto* selected_engine = engine::from_str(engine_name);
+    if (selected_engine == nullptr) {
+        spdlog::critical("Unknown engine \"{}\"", engine_name);
+        return EXIT_FAILURE;
+    }
+    spdlog::trace("Engine: {}", selected_engine->name);
+
     // if list-platforms or list-devices is specified, process when appropriate and then exit
     bool list_platforms = argparse["--list-platforms"] == true;
     bool list_devices = argparse["--list-devices"] == true;
@@ -696,7 +748,15 @@ int main(int argc, char* argv[]) {
     }
     auto_release program_release{program, clReleaseProgram};
     spdlog::trace("Created OpenCL program");
-    err = clBuildProgram(program, 1, &device, nullptr, nullptr, nullptr);
+    const auto threshold = argparse.get<int>("--threshold");
+    if (threshold < 0 || threshold > 255) {
+        spdlog::critical("Threshold must be between 0 and 255");
+        return EXIT_FAILURE;
+    }
+    const std::string build_options = "-DSEARCH=" + std::string(selected_engine->search_function) +
+                                      " -DTHRESHOLD=" + std::to_string(threshold);
+    spdlog::trace("Build options: {}", build_options);
+    err = clBuildProgram(program, 1, &device, build_options.c_str(), nullptr, nullptr);
     if (err != CL_SUCCESS) {
         spdlog::critical("Error building OpenCL program (OpenCL error: {})", err);
         clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &aux_size);
@@ -1,8 +1,13 @@
 R"STRING_CL(
+// threshold pixels are tested against, chosen at build time
+#ifndef THRESHOLD
+#define THRESHOLD 127
+#endif
+
     // map pixel byte to bool
     static bool
     map_read(uchar byte) {
-    unsigned char threshold = 127;
+    unsigned char threshold = THRESHOLD;
     return byte > threshold;
 }
 
@@ -31,7 +36,7 @@ static void set_bounds(ulong2 point, ulong2 dim, ulong2* lb, ulong2* ub, ulong s
     ub->x = spread > (dim.x - point.x) ? dim.x : point.x + spread;
 }
 
-// search strategies
+// search strategies, the one used by the sdf kernel is chosen at build time through SEARCH
 // in general, every search strategy must return a pixel--which is different in value from this_val--for which there is
 // no other pixel with a smaller distance to this_px (x,y).
 // if none found, return this_px
@@ -190,6 +195,10 @@ static ulong2 search_triangle(bool this_val, ulong2 this_px, ulong2 dim, ulong s
     return closest_px;
 }
 
+#ifndef SEARCH
+#define SEARCH search_triangle
+#endif
+
 kernel void sdf(read_only image2d_t img_in, write_only image2d_t img_out, ulong spread, //
                 uchar use_luminence, uchar invert, uchar asymmetric) {
     size_t w = get_global_size(0);
@@ -200,7 +209,7 @@ kernel void sdf(read_only image2d_t img_in, write_only image2d_t img_out, ulong
     ulong y = (ulong)get_global_id(1);
     bool this_val = read((int2)(x, y), img_in, use_luminence);
 
-    ulong2 closest_px = search_triangle(this_val, (ulong2)(x, y), (ulong2)(w, h), spread, img_in, use_luminence);
+    ulong2 closest_px = SEARCH(this_val, (ulong2)(x, y), (ulong2)(w, h), spread, img_in, use_luminence);
     bool found_candidate = any(closest_px != (ulong2)(x, y));
 
     // compute distance to pixel
@@ -0,0 +1,368 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "backend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "stb/stb_image_write.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define OPENCL_EXE_NAME "chaq_sdfgen_opencl.exe"
+#define PATH_SEPARATORS "\\/"
+#else
+#define OPENCL_EXE_NAME "chaq_sdfgen_opencl"
+#define PATH_SEPARATORS "/"
+#endif
+
+// calibration workloads, sizes are image side lengths
+#define CAL_SMALL 128
+#define CAL_LARGE 1024
+#define CAL_SPREAD_LOW 4
+#define CAL_SPREAD_HIGH 32
+#define CAL_RUNS 3
+
+enum BACKEND read_backend(const char* string) {
+    const char* type_table[] = {"omp", "opencl", "auto"};
+    size_t n_types = sizeof(type_table) / sizeof(const char*);
+    for (size_t backend = 0; backend < n_types; ++backend) {
+        if (strcmp(string, type_table[backend]) == 0) return (enum BACKEND)backend;
+    }
+    return BE_NONE;
+}
+
+void backend_opencl_exe(const char* argv0, char* path_out, size_t path_size) {
+    const char* env = getenv("CHAQ_SDFGEN_OPENCL");
+    if (env != NULL) {
+        snprintf(path_out, path_size, "%s", env);
+        return;
+    }
+
+    // same directory as this program, otherwise rely on PATH
+    size_t dir_len = 0;
+    for (size_t i = 0; argv0[i]; ++i) {
+        if (strchr(PATH_SEPARATORS, argv0[i]) != NULL) dir_len = i + 1;
+    }
+    snprintf(path_out, path_size, "%.*s%s", (int)dir_len, argv0, OPENCL_EXE_NAME);
+}
+
+static void calibration_path(char* path_out, size_t path_size) {
+    const char* env = getenv("CHAQ_SDFGEN_CALIBRATION");
+    if (env != NULL) {
+        snprintf(path_out, path_size, "%s", env);
+        return;
+    }
+#ifdef _WIN32
+    const char* home = getenv("USERPROFILE");
+#else
+    const char* home = getenv("HOME");
+#endif
+    snprintf(path_out, path_size, "%s/.chaq_sdfgen_calibration", home != NULL ? home : ".");
+}
+
+// appends a shell-quoted argument to cmd, returns false (leaving cmd unusable) if it does not fit
+static bool append_arg(char* cmd, size_t cmd_size, const char* arg) {
+    size_t len = strlen(cmd);
+    if (len > 0) {
+        if (len + 1 >= cmd_size) return false;
+        cmd[len++] = ' ';
+    }
+#ifdef _WIN32
+    int written = snprintf(cmd + len, cmd_size - len, "\"%s\"", arg);
+    return written >= 0 && (size_t)written < cmd_size - len;
+#else
+    if (len + 1 >= cmd_size) return false;
+    cmd[len++] = '\'';
+    for (; *arg; ++arg) {
+        // room for the longest escape, the closing quote and the terminator
+        if (len + 6 > cmd_size) return false;
+        if (*arg == '\'') {
+            memcpy(cmd + len, "'\\''", 4);
+            len += 4;
+        } else {
+            cmd[len++] = *arg;
+        }
+    }
+    if (len + 2 > cmd_size) return false;
+    cmd[len++] = '\'';
+    cmd[len] = '\0';
+    return true;
+#endif
+}
+
+int backend_run_opencl(const char* opencl_exe, const char* const* args, size_t n_args, const unsigned char* input_data,
+                       size_t input_size) {
+    char cmd[4096] = "";
+    bool fits = append_arg(cmd, sizeof(cmd), opencl_exe);
+    for (size_t i = 0; fits && i < n_args; ++i) fits = append_arg(cmd, sizeof(cmd), args[i]);
+    if (!fits) return BACKEND_COMMAND_TOO_LONG;
+
+    if (input_data == NULL) {
+        // child inherits stdout so "-o -" passes straight through
+        fflush(stdout);
+        return system(cmd);
+    }
+
+#ifdef _WIN32
+    FILE* pipe = popen(cmd, "wb");
+#else
+    FILE* pipe = popen(cmd, "w");
+#endif
+    if (pipe == NULL) return -1;
+    fwrite(input_data, 1, input_size, pipe);
+    return pclose(pipe);
+}
+
+// writes a square grey-alpha test image with a disc and a bar, resembling typical glyph masks
+static bool write_calibration_image(const char* path, size_t side) {
+    unsigned char* img = malloc(side * side * 2);
+    if (img == NULL) return false;
+
+    float c = (float)side * 0.5f;
+    float r = (float)side * 0.3f;
+    for (size_t y = 0; y < side; ++y) {
+        for (size_t x = 0; x < side; ++x) {
+            float dx = (float)x - c;
+            float dy = (float)y - c;
+            bool disc = dx * dx + dy * dy < r * r;
+            bool bar = x > side / 8 && x < side / 5;
+            unsigned char v = (disc || bar) ? 255 : 0;
+            img[(y * side + x) * 2 + 0] = v;
+            img[(y * side + x) * 2 + 1] = v;
+        }
+    }
+
+    int status = stbi_write_png(path, (int)side, (int)side, 2, img, (int)side * 2);
+    free(img);
+    return status != 0;
+}
+
+// median wall time in seconds of running exe on the calibration image, negative on failure
+static double time_run(const char* exe, const char* backend_arg, const char* device, const char* in_path,
+                       const char* out_path, size_t spread) {
+    char cmd[4096] = "";
+    char spread_str[32];
+    snprintf(spread_str, sizeof(spread_str), "%zu", spread);
+
+    bool fits = append_arg(cmd, sizeof(cmd), exe);
+    if (backend_arg != NULL) {
+        fits = fits && append_arg(cmd, sizeof(cmd), "--backend");
+        fits = fits && append_arg(cmd, sizeof(cmd), backend_arg);
+    }
+    if (device != NULL) {
+        fits = fits && append_arg(cmd, sizeof(cmd), "--device");
+        fits = fits && append_arg(cmd, sizeof(cmd), device);
+    }
+    fits = fits && append_arg(cmd, sizeof(cmd), "-i");
+    fits = fits && append_arg(cmd, sizeof(cmd), in_path);
+    fits = fits && append_arg(cmd, sizeof(cmd), "-o");
+    fits = fits && append_arg(cmd, sizeof(cmd), out_path);
+    fits = fits && append_arg(cmd, sizeof(cmd), "-s");
+    fits = fits && append_arg(cmd, sizeof(cmd), spread_str);
+    if (!fits) return -1.0;
+
+    double times[CAL_RUNS];
+    for (size_t run = 0; run < CAL_RUNS; ++run) {
+        double t_start = omp_get_wtime();
+        if (system(cmd) != 0) return -1.0;
+        times[run] = omp_get_wtime() - t_start;
+    }
+
+    // sort the handful of samples and take the middle
+    for (size_t i = 1; i < CAL_RUNS; ++i) {
+        for (size_t j = i; j > 0 && times[j - 1] > times[j]; --j) {
+            double t = times[j];
+            times[j] = times[j - 1];
+            times[j - 1] = t;
+        }
+    }
+    return times[CAL_RUNS / 2];
+}
+
+// first device listed by the opencl program, used to key the calibration
+static void query_default_device(const char* opencl_exe, char* name_out, size_t name_size) {
+    char cmd[4096] = "";
+    snprintf(name_out, name_size, "default");
+    if (!append_arg(cmd, sizeof(cmd), opencl_exe) || !append_arg(cmd, sizeof(cmd), "--list-devices")) return;
+
+    FILE* pipe = popen(cmd, "r");
+    if (pipe == NULL) return;
+    char line[256];
+    if (fgets(line, sizeof(line), pipe) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0]) snprintf(name_out, name_size, "%s", line);
+    }
+    pclose(pipe);
+}
+
+// Calibration file lines are "device\tcoefficients" per device, plus "#default\tdevice" naming the device used
+// without --device, wherever the lines are
+
+#define DEFAULT_MARKER "#default\t"
+
+// whether line starts with the name field given by prefix (up to its tab) followed by a tab
+static bool line_names(const char* line, const char* prefix, const char* name) {
+    size_t prefix_len = strlen(prefix);
+    size_t name_len = strlen(name);
+    return strncmp(line, prefix, prefix_len) == 0 && strncmp(line + prefix_len, name, name_len) == 0 &&
+           line[prefix_len + name_len] == '\t';
+}
+
+// is_default -- calibrated without --device, the entry becomes the one used without it
+static bool save_calibration(const struct backend_calibration* cal, bool is_default) {
+    char path[1024];
+    calibration_path(path, sizeof(path));
+
+    // keep entries of other devices, and which device is the default unless it changes
+    char* kept = NULL;
+    size_t kept_size = 0;
+    FILE* in = fopen(path, "r");
+    if (in != NULL) {
+        char line[512];
+        while (fgets(line, sizeof(line), in) != NULL) {
+            if (line_names(line, "", cal->device)) continue;
+            if (is_default && strncmp(line, DEFAULT_MARKER, strlen(DEFAULT_MARKER)) == 0) continue;
+            size_t line_len = strlen(line);
+            char* grown = realloc(kept, kept_size + line_len + 1);
+            if (grown == NULL) break;
+            kept = grown;
+            memcpy(kept + kept_size, line, line_len + 1);
+            kept_size += line_len;
+        }
+        fclose(in);
+    }
+
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        free(kept);
+        return false;
+    }
+    if (kept != NULL) fputs(kept, out);
+    if (is_default) fprintf(out, DEFAULT_MARKER "%s\n", cal->device);
+    fprintf(out, "%s\t%d %.9g %.9g %.9g %.9g %.9g\n", cal->device, cal->omp_threads, cal->omp_setup, cal->omp_px,
+            cal->ocl_setup, cal->ocl_px, cal->ocl_px_s2);
+    fclose(out);
+    free(kept);
+    return true;
+}
+
+bool backend_load_calibration(const char* device, struct backend_calibration* cal_out) {
+    char path[1024];
+    calibration_path(path, sizeof(path));
+
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return false;
+
+    // without a requested device, the marker names the default one
+    char line[512];
+    char default_device[sizeof(cal_out->device)] = "";
+    while (device == NULL && fgets(line, sizeof(line), in) != NULL) {
+        if (strncmp(line, DEFAULT_MARKER, strlen(DEFAULT_MARKER)) != 0) continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        snprintf(default_device, sizeof(default_device), "%s", line + strlen(DEFAULT_MARKER));
+        device = default_device;
+    }
+    if (device == NULL || fseek(in, 0, SEEK_SET) != 0) {
+        fclose(in);
+        return false;
+    }
+
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), in) != NULL) {
+        if (!line_names(line, "", device)) continue;
+
+        struct backend_calibration cal;
+        size_t name_len = strlen(device);
+        snprintf(cal.device, sizeof(cal.device), "%s", device);
+        found = sscanf(line + name_len + 1, "%d %lf %lf %lf %lf %lf", &cal.omp_threads, &cal.omp_setup, &cal.omp_px,
+                       &cal.ocl_setup, &cal.ocl_px, &cal.ocl_px_s2) == 6;
+        if (found) *cal_out = cal;
+    }
+    fclose(in);
+    return found;
+}
+
+bool backend_calibrate(const char* argv0, const char* opencl_exe, const char* device,
+                       struct backend_calibration* cal_out) {
+    char path[1024];
+    char small_path[1100];
+    char large_path[1100];
+    char out_path[1100];
+    calibration_path(path, sizeof(path));
+    snprintf(small_path, sizeof(small_path), "%s.small.png", path);
+    snprintf(large_path, sizeof(large_path), "%s.large.png", path);
+    snprintf(out_path, sizeof(out_path), "%s.out.png", path);
+
+    bool ok = write_calibration_image(small_path, CAL_SMALL) && write_calibration_image(large_path, CAL_LARGE);
+
+    double t_omp_small = -1.0, t_omp_large = -1.0;
+    double t_ocl_small = -1.0, t_ocl_large = -1.0, t_ocl_large_wide = -1.0;
+    if (ok) {
+        t_omp_small = time_run(argv0, "omp", NULL, small_path, out_path, CAL_SPREAD_LOW);
+        t_omp_large = time_run(argv0, "omp", NULL, large_path, out_path, CAL_SPREAD_LOW);
+        t_ocl_small = time_run(opencl_exe, NULL, device, small_path, out_path, CAL_SPREAD_LOW);
+        t_ocl_large = time_run(opencl_exe, NULL, device, large_path, out_path, CAL_SPREAD_LOW);
+        t_ocl_large_wide = time_run(opencl_exe, NULL, device, large_path, out_path, CAL_SPREAD_HIGH);
+    }
+
+    remove(small_path);
+    remove(large_path);
+    remove(out_path);
+
+    if (!ok || t_omp_small < 0 || t_omp_large < 0) return false;
+
+    struct backend_calibration cal;
+    if (device != NULL) {
+        snprintf(cal.device, sizeof(cal.device), "%s", device);
+    } else {
+        query_default_device(opencl_exe, cal.device, sizeof(cal.device));
+    }
+    cal.omp_threads = omp_get_max_threads();
+
+    double px_small = (double)CAL_SMALL * CAL_SMALL;
+    double px_large = (double)CAL_LARGE * CAL_LARGE;
+    double s2_low = (double)CAL_SPREAD_LOW * CAL_SPREAD_LOW;
+    double s2_high = (double)CAL_SPREAD_HIGH * CAL_SPREAD_HIGH;
+
+    cal.omp_px = fmax(0.0, (t_omp_large - t_omp_small) / (px_large - px_small));
+    cal.omp_setup = fmax(0.0, t_omp_small - cal.omp_px * px_small);
+
+    if (t_ocl_small < 0 || t_ocl_large < 0 || t_ocl_large_wide < 0) {
+        // opencl unusable on this machine, make sure auto never picks it
+        cal.ocl_setup = INFINITY;
+        cal.ocl_px = 0.0;
+        cal.ocl_px_s2 = 0.0;
+    } else {
+        cal.ocl_px_s2 = fmax(0.0, (t_ocl_large_wide - t_ocl_large) / (px_large * (s2_high - s2_low)));
+        double per_px = (t_ocl_large - t_ocl_small) / (px_large - px_small);
+        cal.ocl_px = fmax(0.0, per_px - cal.ocl_px_s2 * s2_low);
+        cal.ocl_setup = fmax(0.0, t_ocl_small - per_px * px_small);
+    }
+
+    *cal_out = cal;
+    return save_calibration(&cal, device == NULL);
+}
+
+enum BACKEND backend_choose(const struct backend_calibration* cal, size_t w, size_t h, size_t spread) {
+    if (cal == NULL) return BE_OMP;
+
+    double px = (double)w * (double)h;
+    // searches never reach past the image, so spread beyond its size costs nothing extra
+    double s = (double)(spread < (w > h ? w : h) ? spread : (w > h ? w : h));
+
+    // per pixel cost scales inversely with the thread count used during calibration
+    int threads = omp_get_max_threads();
+    double thread_scale = threads > 0 && cal->omp_threads > 0 ? (double)cal->omp_threads / threads : 1.0;
+
+    double t_omp = cal->omp_setup + cal->omp_px * px * thread_scale;
+    double t_ocl = cal->ocl_setup + cal->ocl_px * px + cal->ocl_px_s2 * px * s * s;
+    return t_ocl < t_omp ? BE_OPENCL : BE_OMP;
+}
@@ -0,0 +1,45 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum BACKEND { BE_NONE = -1, BE_OMP, BE_OPENCL, BE_AUTO };
+
+// Cost model coefficients for one OpenCL device, all in seconds
+// omp: t = omp_setup + omp_px * w * h
+// opencl: t = ocl_setup + ocl_px * w * h + ocl_px_s2 * w * h * s^2
+struct backend_calibration {
+    char device[128];
+    int omp_threads;
+    double omp_setup;
+    double omp_px;
+    double ocl_setup;
+    double ocl_px;
+    double ocl_px_s2;
+};
+
+enum BACKEND read_backend(const char* string);
+
+// Path of the opencl program, looked up next to this program unless overridden by CHAQ_SDFGEN_OPENCL
+void backend_opencl_exe(const char* argv0, char* path_out, size_t path_size);
+
+// Loads calibration for device (NULL for the one last calibrated without --device), returns false if none was stored
+bool backend_load_calibration(const char* device, struct backend_calibration* cal_out);
+
+// Runs the micro-benchmark through both programs and stores the result on disk
+bool backend_calibrate(const char* argv0, const char* opencl_exe, const char* device,
+                       struct backend_calibration* cal_out);
+
+// Picks the backend with the lower predicted time, falls back to BE_OMP without calibration
+enum BACKEND backend_choose(const struct backend_calibration* cal, size_t w, size_t h, size_t spread);
+
+// returned by backend_run_opencl when the arguments do not fit its command line, which is then not run
+#define BACKEND_COMMAND_TOO_LONG (-2)
+
+// Runs the opencl program with the given arguments, feeding it input_data on stdin if non-NULL
+// Returns the exit status of the program, -1 if it could not be started or BACKEND_COMMAND_TOO_LONG
+int backend_run_opencl(const char* opencl_exe, const char* const* args, size_t n_args, const unsigned char* input_data,
+                       size_t input_size);
+
+#endif
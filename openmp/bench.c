@@ -0,0 +1,103 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "df.h"
+
+// fills both fields the same way the generator does, inside is 0 at true pixels and outside is 0 at false pixels
+static void fill_fields(const bool* mask, float* inside, float* outside, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        inside[i] = mask[i] ? 0.f : INFINITY;
+        outside[i] = mask[i] ? INFINITY : 0.f;
+    }
+}
+
+// accumulates absolute error of result against reference, mismatched infinities count as unbounded error
+static void accumulate_error(const float* result, const float* reference, size_t n, double* max_err, double* sum_err,
+                             size_t* count) {
+    for (size_t i = 0; i < n; ++i) {
+        if (isinf(result[i]) || isinf(reference[i])) {
+            if (isinf(result[i]) != isinf(reference[i])) *max_err = INFINITY;
+            continue;
+        }
+        double err = fabs((double)result[i] - (double)reference[i]);
+        *max_err = err > *max_err ? err : *max_err;
+        *sum_err += err;
+        ++*count;
+    }
+}
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+bool bench_engines(const bool* mask, size_t w, size_t h, size_t runs) {
+    size_t n = w * h;
+    float* ref_inside = malloc(n * sizeof(float));
+    float* ref_outside = malloc(n * sizeof(float));
+    float* inside = malloc(n * sizeof(float));
+    float* outside = malloc(n * sizeof(float));
+    double* times = malloc((runs > 0 ? runs : 1) * sizeof(double));
+    if (ref_inside == NULL || ref_outside == NULL || inside == NULL || outside == NULL || times == NULL) {
+        free(times);
+        free(outside);
+        free(inside);
+        free(ref_outside);
+        free(ref_inside);
+        return false;
+    }
+    if (runs == 0) runs = 1;
+
+    const struct df_engine* reference = &df_engines[0];
+    fill_fields(mask, ref_inside, ref_outside, n);
+    reference->transform_2d(ref_inside, w, h, NULL);
+    reference->transform_2d(ref_outside, w, h, NULL);
+
+    printf("%zux%zu, median of %zu runs, error against %s\n", w, h, runs, reference->name);
+    printf("%-16s %12s %12s %12s\n", "engine", "time (ms)", "max err", "mean err");
+
+    for (size_t e = 0; e < df_num_engines; ++e) {
+        const struct df_engine* engine = &df_engines[e];
+        if (engine->max_pixels != 0 && n > engine->max_pixels) {
+            printf("%-16s %12s\n", engine->name, "skipped");
+            continue;
+        }
+
+        for (size_t run = 0; run < runs; ++run) {
+            fill_fields(mask, inside, outside, n);
+            double t_start = omp_get_wtime();
+            engine->transform_2d(inside, w, h, NULL);
+            engine->transform_2d(outside, w, h, NULL);
+            times[run] = omp_get_wtime() - t_start;
+        }
+        qsort(times, runs, sizeof(double), compare_double);
+        // distances of another metric have no error against the reference
+        if (engine->metric != reference->metric) {
+            printf("%-16s %12.3f %12s %12s\n", engine->name, times[runs / 2] * 1000.0, "-", "-");
+            continue;
+        }
+
+        double max_err = 0.0;
+        double sum_err = 0.0;
+        size_t count = 0;
+        accumulate_error(inside, ref_inside, n, &max_err, &sum_err, &count);
+        accumulate_error(outside, ref_outside, n, &max_err, &sum_err, &count);
+
+        printf("%-16s %12.3f %12.4f %12.4f\n", engine->name, times[runs / 2] * 1000.0, max_err,
+               count > 0 ? sum_err / (double)count : 0.0);
+    }
+
+    free(times);
+    free(outside);
+    free(inside);
+    free(ref_outside);
+    free(ref_inside);
+    return true;
+}
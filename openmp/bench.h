@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runs every registered engine on the inside and outside fields of mask and prints timing and the error against the
+// reference engine, for engines of its metric, to stdout. Returns false if a buffer could not be allocated.
+bool bench_engines(const bool* mask, size_t w, size_t h, size_t runs);
+
+#endif
@@ -0,0 +1,152 @@
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// buckets of the key table, the cache holds far fewer entries than this in practice
+#define CACHE_BUCKETS 1024
+
+uint64_t cache_hash(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool cache_init(struct result_cache* cache, size_t capacity) {
+    cache->buckets = calloc(CACHE_BUCKETS, sizeof(struct cache_entry*));
+    cache->n_buckets = CACHE_BUCKETS;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->bytes = 0;
+    cache->capacity = capacity;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->coalesced = 0;
+    return cache->buckets != NULL;
+}
+
+static void free_entry(struct cache_entry* entry) {
+    free(entry->material);
+    free(entry->data);
+    free(entry);
+}
+
+void cache_free(struct result_cache* cache) {
+    struct cache_entry* entry = cache->newest;
+    while (entry != NULL) {
+        struct cache_entry* older = entry->older;
+        free_entry(entry);
+        entry = older;
+    }
+    free(cache->buckets);
+    cache->buckets = NULL;
+}
+
+static void unlink_order(struct result_cache* cache, struct cache_entry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void push_newest(struct result_cache* cache, struct cache_entry* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) cache->newest->newer = entry;
+    cache->newest = entry;
+    if (cache->oldest == NULL) cache->oldest = entry;
+}
+
+static void unlink_bucket(struct result_cache* cache, struct cache_entry* entry) {
+    for (struct cache_entry** link = &cache->buckets[entry->key % cache->n_buckets]; *link != NULL;
+         link = &(*link)->chain) {
+        if (*link == entry) {
+            *link = entry->chain;
+            break;
+        }
+    }
+    entry->chain = NULL;
+}
+
+// evicts unheld filled entries, least recently used first, until the cache fits
+static void trim(struct result_cache* cache) {
+    struct cache_entry* entry = cache->oldest;
+    while (entry != NULL && cache->bytes > cache->capacity) {
+        struct cache_entry* newer = entry->newer;
+        if (entry->ready && entry->n_users == 0) {
+            unlink_bucket(cache, entry);
+            unlink_order(cache, entry);
+            cache->bytes -= entry->size + entry->material_size;
+            free_entry(entry);
+        }
+        entry = newer;
+    }
+}
+
+struct cache_entry* cache_acquire(struct result_cache* cache, uint64_t key, const unsigned char* material,
+                                  size_t material_size) {
+    struct cache_entry* entry = cache->buckets[key % cache->n_buckets];
+    while (entry != NULL && (entry->key != key || entry->material_size != material_size ||
+                             memcmp(entry->material, material, material_size) != 0)) {
+        entry = entry->chain;
+    }
+    if (entry == NULL) return NULL;
+
+    unlink_order(cache, entry);
+    push_newest(cache, entry);
+    ++entry->n_users;
+    return entry;
+}
+
+struct cache_entry* cache_reserve(struct result_cache* cache, uint64_t key, unsigned char* material,
+                                  size_t material_size, void* owner) {
+    struct cache_entry* entry = calloc(1, sizeof(struct cache_entry));
+    if (entry == NULL) return NULL;
+    entry->key = key;
+    entry->material = material;
+    entry->material_size = material_size;
+    entry->n_users = 1;
+    entry->owner = owner;
+
+    struct cache_entry** bucket = &cache->buckets[key % cache->n_buckets];
+    entry->chain = *bucket;
+    *bucket = entry;
+    push_newest(cache, entry);
+    return entry;
+}
+
+void cache_fill(struct result_cache* cache, struct cache_entry* entry, unsigned char* data, size_t size) {
+    entry->data = data;
+    entry->size = size;
+    entry->ready = true;
+    entry->owner = NULL;
+    cache->bytes += size + entry->material_size;
+    trim(cache);
+}
+
+void cache_abandon(struct result_cache* cache, struct cache_entry* entry) {
+    unlink_bucket(cache, entry);
+    unlink_order(cache, entry);
+    entry->abandoned = true;
+    entry->owner = NULL;
+}
+
+void cache_release(struct result_cache* cache, struct cache_entry* entry) {
+    --entry->n_users;
+    if (entry->abandoned) {
+        if (entry->n_users == 0) free_entry(entry);
+    } else {
+        trim(cache);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Least recently used cache of encoded results, keyed by a hash of the input and the options, bounded in bytes. Each
+// entry keeps the input and options it was hashed from, so keys that collide never share a result.
+// An entry is reserved by the first request for a key and filled once its result is ready, so identical requests
+// arriving meanwhile find it pending and wait for it instead of computing it again. Not thread safe, callers hold
+// their own lock around every call.
+
+#define CACHE_HASH_SEED 0xcbf29ce484222325ull
+
+struct cache_entry {
+    uint64_t key;
+    // what key hashes, compared on every lookup, and counted towards the bytes of the cache once filled
+    unsigned char* material;
+    size_t material_size;
+    unsigned char* data;
+    size_t size;
+    // filled, data is valid
+    bool ready;
+    // the computation failed, the entry is no longer found and goes away with its last user
+    bool abandoned;
+    // requests holding the entry, which keeps it from being evicted
+    size_t n_users;
+    // caller data of the request computing a pending entry
+    void* owner;
+    // next entry of the same bucket
+    struct cache_entry* chain;
+    // neighbours in order of use, most recent first
+    struct cache_entry* newer;
+    struct cache_entry* older;
+};
+
+struct result_cache {
+    struct cache_entry** buckets;
+    size_t n_buckets;
+    struct cache_entry* newest;
+    struct cache_entry* oldest;
+    // bytes of all filled entries, results and key material
+    size_t bytes;
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+    // requests that waited for a pending entry
+    size_t coalesced;
+};
+
+// FNV-1a of size bytes continuing from hash, start from CACHE_HASH_SEED
+uint64_t cache_hash(uint64_t hash, const void* data, size_t size);
+
+// capacity in bytes of encoded results and their key material kept, returns false if out of memory
+bool cache_init(struct result_cache* cache, size_t capacity);
+
+void cache_free(struct result_cache* cache);
+
+// Entry for key hashed from material, ready or pending, or NULL. A found entry becomes the most recent and is held by
+// the caller until cache_release.
+struct cache_entry* cache_acquire(struct result_cache* cache, uint64_t key, const unsigned char* material,
+                                  size_t material_size);
+
+// Adds a pending entry for key computed by owner and held by it, taking ownership of material (malloc'd) unless it
+// returns NULL for out of memory
+struct cache_entry* cache_reserve(struct result_cache* cache, uint64_t key, unsigned char* material,
+                                  size_t material_size, void* owner);
+
+// Fills a pending entry, taking ownership of data (malloc'd), then evicts the least recently used unheld entries
+// until the cache fits its capacity. A result larger than the capacity is still handed to the waiting requests.
+void cache_fill(struct result_cache* cache, struct cache_entry* entry, unsigned char* data, size_t size);
+
+// Gives up a pending entry whose computation failed, its waiting requests have to look the key up again
+void cache_abandon(struct result_cache* cache, struct cache_entry* entry);
+
+// Drops the caller's hold on entry
+void cache_release(struct result_cache* cache, struct cache_entry* entry);
+
+#endif
@@ -0,0 +1,481 @@
+// Correctness checks run by CTest on small synthetic inputs
+// usage: chaq_sdfgen_check case
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "df.h"
+#include "sdf.h"
+#include "shard.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#define CHECK_WIDTH 97
+#define CHECK_HEIGHT 83
+#define CHECK_SPREAD 4
+
+// sparse discs and speckles, far enough apart that most pixels saturate, the same for a given seed
+static void synthetic_mask(bool* mask, size_t w, size_t h, uint32_t seed) {
+    uint32_t state = seed;
+    for (size_t y = 0; y < h; ++y) {
+        for (size_t x = 0; x < w; ++x) {
+            size_t cx = (x / 40) * 40 + 20;
+            size_t cy = (y / 40) * 40 + 20;
+            float r = 3.f + (float)((cx * 7 + cy * 13 + seed) % 9);
+            float dx = (float)x - (float)cx;
+            float dy = (float)y - (float)cy;
+            state = state * 1664525u + 1013904223u;
+            bool speckle = (state >> 24) < 1;
+            mask[y * w + x] = (dx * dx + dy * dy < r * r) != speckle;
+        }
+    }
+}
+
+// reads the rows of a shard file written by shard_generate or shard_generate_tiled into image at their place
+static bool read_shard(const char* path, size_t row_size, unsigned char* image) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    struct shard_header header;
+    size_t n_rows = 0;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    if (ok) {
+        n_rows = header.y1 - header.y0;
+        ok = fread(image + header.y0 * row_size, row_size, n_rows, file) == n_rows;
+    }
+    fclose(file);
+    return ok;
+}
+
+// first differing byte of two outputs, or size if they are identical
+static size_t first_difference(const unsigned char* a, const unsigned char* b, size_t size) {
+    size_t i = 0;
+    while (i < size && a[i] == b[i]) ++i;
+    return i;
+}
+
+// merged shards and tiled bands reproduce the whole image byte for byte, for every output layout
+static bool check_shard_layouts(void) {
+    size_t w = CHECK_WIDTH;
+    size_t h = CHECK_HEIGHT;
+    bool* mask = malloc(w * h * sizeof(bool));
+    unsigned char* full = malloc(w * h * 4);
+    unsigned char* pieced = malloc(w * h * 4);
+    if (mask == NULL || full == NULL || pieced == NULL) {
+        free(pieced);
+        free(full);
+        free(mask);
+        return false;
+    }
+    synthetic_mask(mask, w, h, 1);
+
+    const enum GRADIENT gradients[] = {GR_DISTANCE, GR_RG, GR_NORMAL};
+    const char* gradient_names[] = {"distance", "rg", "normal"};
+    bool ok = true;
+    for (size_t g = 0; g < 3; ++g) {
+        for (int asymmetric = 0; asymmetric < 2; ++asymmetric) {
+            struct sdf_params params = {df_find_engine("fh"), CHECK_SPREAD, asymmetric, NULL, 0, gradients[g],
+                                        BD_CLIP, 0, 0, 0, 0, 0, NULL};
+            size_t row_size = w * sdf_channels(&params);
+            if (!sdf_generate(mask, w, h, &params, full)) {
+                ok = false;
+                continue;
+            }
+
+            // four shards, each from the mask rows of its window only
+            memset(pieced, 0, h * row_size);
+            bool generated = true;
+            for (size_t index = 0; index < 4; ++index) {
+                struct shard shard = shard_plan(index, 4, h, sdf_reach(&params));
+                generated = generated &&
+                            shard_generate(&shard, mask + shard.window_y0 * w, w, h, &params, "check_shard.raw") &&
+                            read_shard("check_shard.raw", row_size, pieced);
+            }
+            size_t diff = first_difference(full, pieced, h * row_size);
+            if (!generated || diff < h * row_size) {
+                printf("%s%s: shards differ from the whole image at byte %zu\n", gradient_names[g],
+                       asymmetric ? " asymmetric" : "", diff);
+                ok = false;
+            }
+
+            // bands of a tiled file, smaller than the reach
+            memset(pieced, 0, h * row_size);
+            generated = shard_generate_tiled(mask, w, h, 5, &params, "check_tiled.raw", false) &&
+                        read_shard("check_tiled.raw", row_size, pieced);
+            diff = first_difference(full, pieced, h * row_size);
+            if (!generated || diff < h * row_size) {
+                printf("%s%s: tiled bands differ from the whole image at byte %zu\n", gradient_names[g],
+                       asymmetric ? " asymmetric" : "", diff);
+                ok = false;
+            }
+        }
+    }
+
+    remove("check_shard.raw");
+    remove("check_tiled.raw");
+    remove("check_tiled.raw.journal");
+    free(pieced);
+    free(full);
+    free(mask);
+    return ok;
+}
+
+// progress as a transform reports it, optionally cancelling the job once it passes cancel_at
+struct progress_log {
+    struct df_control* control;
+    double cancel_at;
+    double last;
+    size_t reports;
+    bool monotonic;
+};
+
+static void log_progress(void* context, double fraction) {
+    struct progress_log* log = context;
+    log->monotonic = log->monotonic && fraction > log->last;
+    log->last = fraction;
+    ++log->reports;
+    if (log->cancel_at >= 0.0 && fraction >= log->cancel_at) atomic_store(&log->control->cancel, true);
+}
+
+static bool count_band(void* context, const unsigned char* rows, size_t y0, size_t n_rows) {
+    (void)rows;
+    (void)y0;
+    *(size_t*)context += n_rows;
+    return true;
+}
+
+// every engine reports progress up to 1000 permille in rising steps, and a cancelled job returns false without
+// writing its output, whether cancelled before it starts or from its progress callback midway
+static bool check_control(void) {
+    size_t w = CHECK_WIDTH;
+    size_t h = CHECK_HEIGHT;
+    bool* mask = malloc(w * h * sizeof(bool));
+    unsigned char* out = malloc(w * h);
+    if (mask == NULL || out == NULL) {
+        free(out);
+        free(mask);
+        return false;
+    }
+    synthetic_mask(mask, w, h, 2);
+
+    bool ok = true;
+    for (size_t e = 0; e < df_num_engines; ++e) {
+        const struct df_engine* engine = &df_engines[e];
+        struct df_control control;
+        struct progress_log log = {&control, -1.0, 0.0, 0, true};
+        df_control_init(&control, log_progress, &log);
+        struct sdf_params params = {engine, CHECK_SPREAD, false, NULL, 0, GR_DISTANCE, BD_CLIP, 0, 0, 0, 0, 0,
+                                    &control};
+
+        if (!sdf_generate(mask, w, h, &params, out) || log.last != 1.0 || !log.monotonic) {
+            printf("%s: progress ended at %.3f after %zu reports%s\n", engine->name, log.last, log.reports,
+                   log.monotonic ? "" : ", not rising");
+            ok = false;
+        }
+
+        for (int midway = 0; midway < 2; ++midway) {
+            memset(out, 0xa5, w * h);
+            log = (struct progress_log){&control, midway ? 0.25 : -1.0, 0.0, 0, true};
+            df_control_init(&control, log_progress, &log);
+            if (!midway) atomic_store(&control.cancel, true);
+
+            bool finished = sdf_generate(mask, w, h, &params, out);
+            size_t touched = 0;
+            for (size_t i = 0; i < w * h; ++i) touched += out[i] != 0xa5;
+            if (finished || touched > 0) {
+                printf("%s: cancelled %s, %s with %zu output bytes written\n", engine->name,
+                       midway ? "midway" : "before starting", finished ? "finished" : "stopped", touched);
+                ok = false;
+            }
+        }
+    }
+
+    // the streamed pipeline reports the same way and stops emitting once cancelled
+    struct df_control control;
+    struct progress_log log = {&control, -1.0, 0.0, 0, true};
+    df_control_init(&control, log_progress, &log);
+    struct sdf_params params = {df_find_engine("fh"), CHECK_SPREAD, false, NULL, 0, GR_DISTANCE, BD_CLIP, 0, 0, 0, 0, 0,
+                                &control};
+    size_t rows = 0;
+    if (!sdf_generate_streamed(mask, w, h, &params, 8, count_band, &rows) || rows != h || log.last != 1.0 ||
+        !log.monotonic) {
+        printf("streamed: %zu of %zu rows, progress ended at %.3f\n", rows, h, log.last);
+        ok = false;
+    }
+    rows = 0;
+    atomic_store(&control.cancel, true);
+    if (sdf_generate_streamed(mask, w, h, &params, 8, count_band, &rows) || rows > 0) {
+        printf("streamed: cancelled before starting, emitted %zu rows\n", rows);
+        ok = false;
+    }
+
+    free(out);
+    free(mask);
+    return ok;
+}
+
+// masks for comparisons against brute force: the synthetic discs, dense noise, and a few sites at one end of a wide
+// image, whose distances run past 255
+struct test_mask {
+    size_t w;
+    size_t h;
+    bool* mask;
+};
+
+static size_t test_masks(struct test_mask* masks) {
+    masks[0] = (struct test_mask){CHECK_WIDTH, CHECK_HEIGHT, malloc(CHECK_WIDTH * CHECK_HEIGHT * sizeof(bool))};
+    masks[1] = (struct test_mask){61, 53, malloc(61 * 53 * sizeof(bool))};
+    masks[2] = (struct test_mask){300, 41, malloc(300 * 41 * sizeof(bool))};
+    for (size_t m = 0; m < 3; ++m) {
+        if (masks[m].mask == NULL) return m;
+    }
+
+    synthetic_mask(masks[0].mask, masks[0].w, masks[0].h, 3);
+    uint32_t state = 777;
+    for (size_t i = 0; i < masks[1].w * masks[1].h; ++i) {
+        state = state * 1664525u + 1013904223u;
+        masks[1].mask[i] = (state >> 24) < 40;
+    }
+    memset(masks[2].mask, 0, masks[2].w * masks[2].h * sizeof(bool));
+    masks[2].mask[0] = true;
+    masks[2].mask[17 * masks[2].w + 3] = true;
+    masks[2].mask[40 * masks[2].w] = true;
+    return 3;
+}
+
+// distances of one field of mask through transform, sites where mask is site_value
+static void transform_field(df_transform_fn transform, const bool* mask, bool site_value, size_t w, size_t h,
+                            float* field) {
+    for (size_t i = 0; i < w * h; ++i) field[i] = mask[i] == site_value ? 0.f : INFINITY;
+    transform(field, w, h, NULL);
+}
+
+// Whether distances match a reference field, within relative error where the reference is below limit, and are at
+// least limit, less the same error, elsewhere. Prints the first mismatch under name.
+static bool matches(const char* name, const float* field, const float* reference, size_t w, size_t h, float relative,
+                    float limit) {
+    for (size_t i = 0; i < w * h; ++i) {
+        float d = field[i];
+        float r = reference[i];
+        bool ok = r < limit ? d == r || fabsf(d - r) <= relative * r : d >= limit * (1.f - relative);
+        if (!ok) {
+            printf("%s: %zux%zu distance %.6g at (%zu, %zu), expected %.6g\n", name, w, h, d, i % w, i / w, r);
+            return false;
+        }
+    }
+    return true;
+}
+
+// the Felzenszwalb/Huttenlocher storage variants and the Meijster engine against brute force, single and dual field
+// where the engine has one, within the tolerance df.h documents for each
+static bool check_storage(void) {
+    struct {
+        const char* name;
+        float relative;
+        float limit;
+    } variants[] = {
+        {"fh", 0.f, INFINITY},
+        {"fh-u32", 0.f, INFINITY},
+        {"fh-u16", 0.f, 256.f},
+        {"fh-f16", 0.0003f, 256.f},
+        {"meijster", 0.f, INFINITY},
+    };
+
+    struct test_mask masks[3];
+    size_t n_masks = test_masks(masks);
+    bool ok = n_masks == 3;
+    for (size_t m = 0; ok && m < n_masks; ++m) {
+        size_t w = masks[m].w;
+        size_t h = masks[m].h;
+        float* reference = malloc(2 * w * h * sizeof(float));
+        float* field = malloc(2 * w * h * sizeof(float));
+        if (reference == NULL || field == NULL) {
+            free(field);
+            free(reference);
+            ok = false;
+            break;
+        }
+        transform_field(dist_transform_2d_brute, masks[m].mask, true, w, h, reference);
+        transform_field(dist_transform_2d_brute, masks[m].mask, false, w, h, reference + w * h);
+
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+            const struct df_engine* engine = df_find_engine(variants[v].name);
+            transform_field(engine->transform_2d, masks[m].mask, true, w, h, field);
+            transform_field(engine->transform_2d, masks[m].mask, false, w, h, field + w * h);
+            ok = matches(engine->name, field, reference, w, h, variants[v].relative, variants[v].limit) &&
+                 matches(engine->name, field + w * h, reference + w * h, w, h, variants[v].relative,
+                         variants[v].limit) &&
+                 ok;
+
+            if (engine->transform_2d_dual == NULL) continue;
+            engine->transform_2d_dual(masks[m].mask, field, field + w * h, w, h, NULL);
+            ok = matches(engine->name, field, reference, w, h, variants[v].relative, variants[v].limit) &&
+                 matches(engine->name, field + w * h, reference + w * h, w, h, variants[v].relative,
+                         variants[v].limit) &&
+                 ok;
+        }
+        free(field);
+        free(reference);
+    }
+
+    for (size_t m = 0; m < n_masks; ++m) free(masks[m].mask);
+    return ok;
+}
+
+// brute force distances of metric to the pixels where mask is site_value, INFINITY if there are none
+static void brute_metric(enum METRIC metric, const bool* mask, bool site_value, size_t w, size_t h, float* field) {
+    for (size_t y = 0; y < h; ++y) {
+        for (size_t x = 0; x < w; ++x) {
+            float best = INFINITY;
+            for (size_t s = 0; s < w * h; ++s) {
+                if (mask[s] != site_value) continue;
+                float dx = fabsf((float)x - (float)(s % w));
+                float dy = fabsf((float)y - (float)(s / w));
+                float d = metric == MT_L1 ? dx + dy : (dx > dy ? dx : dy);
+                best = d < best ? d : best;
+            }
+            field[y * w + x] = best;
+        }
+    }
+}
+
+// the manhattan and chebyshev engines against brute force, single and dual field, exactly
+static bool check_metrics(void) {
+    const enum METRIC metrics[] = {MT_L1, MT_LINF};
+
+    struct test_mask masks[3];
+    size_t n_masks = test_masks(masks);
+    bool ok = n_masks == 3;
+    for (size_t m = 0; ok && m < n_masks; ++m) {
+        size_t w = masks[m].w;
+        size_t h = masks[m].h;
+        float* reference = malloc(2 * w * h * sizeof(float));
+        float* field = malloc(2 * w * h * sizeof(float));
+        if (reference == NULL || field == NULL) {
+            free(field);
+            free(reference);
+            ok = false;
+            break;
+        }
+
+        for (size_t k = 0; k < 2; ++k) {
+            const struct df_engine* engine = df_metric_engine(metrics[k]);
+            brute_metric(metrics[k], masks[m].mask, true, w, h, reference);
+            brute_metric(metrics[k], masks[m].mask, false, w, h, reference + w * h);
+
+            transform_field(engine->transform_2d, masks[m].mask, true, w, h, field);
+            transform_field(engine->transform_2d, masks[m].mask, false, w, h, field + w * h);
+            ok = matches(engine->name, field, reference, w, h, 0.f, INFINITY) &&
+                 matches(engine->name, field + w * h, reference + w * h, w, h, 0.f, INFINITY) && ok;
+
+            engine->transform_2d_dual(masks[m].mask, field, field + w * h, w, h, NULL);
+            ok = matches(engine->name, field, reference, w, h, 0.f, INFINITY) &&
+                 matches(engine->name, field + w * h, reference + w * h, w, h, 0.f, INFINITY) && ok;
+        }
+        free(field);
+        free(reference);
+    }
+
+    for (size_t m = 0; m < n_masks; ++m) free(masks[m].mask);
+    return ok;
+}
+
+// Whether distances are within absolute plus relative error of a reference field. Prints the first mismatch under
+// name.
+static bool approximates(const char* name, const float* field, const float* reference, size_t w, size_t h,
+                         float relative, float absolute) {
+    for (size_t i = 0; i < w * h; ++i) {
+        float d = field[i];
+        float r = reference[i];
+        if (d != r && fabsf(d - r) > absolute + relative * r) {
+            printf("%s: %zux%zu distance %.6g at (%zu, %zu), expected %.6g\n", name, w, h, d, i % w, i / w, r);
+            return false;
+        }
+    }
+    return true;
+}
+
+// the approximate engines against brute force, within the error df.h documents for each: a share of the distance for
+// the chamfers, a tenth of a pixel for 8SSEDT, whose rare configurations of sites these masks do not contain
+static bool check_approximate(void) {
+    struct {
+        const char* name;
+        float relative;
+        float absolute;
+    } variants[] = {
+        {"chamfer-3-4", 0.06f, 0.f},
+        {"chamfer-5-7-11", 0.02f, 0.f},
+        {"8ssedt", 0.f, 0.1f},
+    };
+
+    struct test_mask masks[3];
+    size_t n_masks = test_masks(masks);
+    bool ok = n_masks == 3;
+    for (size_t m = 0; ok && m < n_masks; ++m) {
+        size_t w = masks[m].w;
+        size_t h = masks[m].h;
+        float* reference = malloc(2 * w * h * sizeof(float));
+        float* field = malloc(2 * w * h * sizeof(float));
+        if (reference == NULL || field == NULL) {
+            free(field);
+            free(reference);
+            ok = false;
+            break;
+        }
+        transform_field(dist_transform_2d_brute, masks[m].mask, true, w, h, reference);
+        transform_field(dist_transform_2d_brute, masks[m].mask, false, w, h, reference + w * h);
+
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+            const struct df_engine* engine = df_find_engine(variants[v].name);
+            transform_field(engine->transform_2d, masks[m].mask, true, w, h, field);
+            transform_field(engine->transform_2d, masks[m].mask, false, w, h, field + w * h);
+            ok = approximates(engine->name, field, reference, w, h, variants[v].relative, variants[v].absolute) &&
+                 approximates(engine->name, field + w * h, reference + w * h, w, h, variants[v].relative,
+                              variants[v].absolute) &&
+                 ok;
+        }
+        free(field);
+        free(reference);
+    }
+
+    for (size_t m = 0; m < n_masks; ++m) free(masks[m].mask);
+    return ok;
+}
+
+struct check_case {
+    const char* name;
+    bool (*run)(void);
+};
+
+static const struct check_case cases[] = {
+    {"shard_layouts", check_shard_layouts},
+    {"control", check_control},
+    {"storage", check_storage},
+    {"metrics", check_metrics},
+    {"approximate", check_approximate},
+};
+static const size_t n_cases = sizeof(cases) / sizeof(cases[0]);
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fputs("usage: chaq_sdfgen_check case\n", stderr);
+        return 2;
+    }
+
+    const struct check_case* selected = NULL;
+    for (size_t c = 0; c < n_cases; ++c) {
+        if (strcmp(cases[c].name, argv[1]) == 0) selected = &cases[c];
+    }
+    if (selected == NULL) {
+        fprintf(stderr, "Unknown case \"%s\".\n", argv[1]);
+        return 2;
+    }
+
+    bool ok = selected->run();
+    printf("%s: %s\n", selected->name, ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -5,132 +5,124 @@
 #include <stdlib.h>
 #include <string.h>
 
-// intersection of 2 parabolas, not defined if both parabolas have vertex y's at infinity
-static float parabola_intersect(float* restrict f, size_t p, size_t q) {
-    float p1_x = (float)p;
-    float p2_x = (float)q;
-    float p1_y = f[p];
-    float p2_y = f[q];
-    return ((p2_y - p1_y) + ((p2_x * p2_x) - (p1_x * p1_x))) / (2 * (p2_x - p1_x));
+void df_control_init(struct df_control* control, void (*progress)(void* context, double fraction), void* context) {
+    atomic_init(&control->cancel, false);
+    control->progress = progress;
+    control->pause = NULL;
+    control->context = context;
+    atomic_init(&control->done, 0);
+    atomic_init(&control->reported, 0);
+    control->total = 0;
 }
 
-// Compute euclidean distance transform in 1d using passed in buffers
-// Reference: Distance Transforms of Sampled Functions (P. Felzenszwalb, D. Huttenlocher):
-//      http://cs.brown.edu/people/pfelzens/dt/
-// img_row -- single row buffer of parabola heights
-// w -- size of img_row
-// y -- current y for transpose
-// v -- vertices buffer, sized w
-// h -- vertex height buffer, sized w
-// z -- break point buffer, associates z[n] with v[n]'s right bound, sized w-1
-// img_tpose_out -- output buffer for distance transform, will be populated in transpose, must be sufficiently large
-// (at minimum w * y)
-// do_sqrt -- whether to compute sqrt of value after computing lower envelope
-static void dist_transform_1d(float* restrict img_row, size_t w, size_t y, size_t* restrict v, float* restrict h,
-                              float* restrict z, float* restrict img_tpose_out, bool do_sqrt) {
-    // Single-cell is already complete
-    if (w <= 1) {
-        // Write back to single cell
-        img_tpose_out[0] = img_row[0];
-        return;
-    }
+void df_control_start(struct df_control* control, size_t total) {
+    if (control == NULL) return;
+    atomic_store(&control->done, 0);
+    atomic_store(&control->reported, 0);
+    control->total = total;
+}
+
+size_t df_work(size_t w, size_t h) { return 2 * w * h; }
+
+bool df_cancelled(struct df_control* control) {
+    if (control == NULL) return false;
+    if (control->pause != NULL) control->pause(control->context);
+    return atomic_load_explicit(&control->cancel, memory_order_relaxed);
+}
 
-    // Part 1: Compute lower envelope as a set of break points and vertices
-    // Start at the first non-infinity parabola
-    size_t offset = 0;
-    while (isinf(img_row[offset]) && offset < w) ++offset;
+void df_progress(struct df_control* control, size_t units) {
+    if (control == NULL) return;
+    size_t done = atomic_fetch_add_explicit(&control->done, units, memory_order_relaxed) + units;
+    if (control->progress == NULL || control->total == 0) return;
 
-    // If lower envelope is all at infinity, we have an empty row, this is complete as far as we care
-    if (offset == w) {
-        // Because we're transposing on writeback, we need to fill empty rows
-        for (size_t i = 0; i < w; ++i) {
-            size_t tpose_idx = y + w * i;
-            img_tpose_out[tpose_idx] = INFINITY;
+    // only whole permille steps are reported, so the callback stays rare and the lock is almost never taken
+    size_t permille = done >= control->total ? 1000 : done * 1000 / control->total;
+    if (permille <= atomic_load_explicit(&control->reported, memory_order_relaxed)) return;
+#pragma omp critical(df_progress)
+    {
+        if (permille > atomic_load_explicit(&control->reported, memory_order_relaxed)) {
+            atomic_store_explicit(&control->reported, permille, memory_order_relaxed);
+            control->progress(control->context, (double)permille / 1000.0);
         }
-        return;
     }
+}
 
-    // First vertex is that of the first parabola
-    v[0] = offset;
-    h[0] = img_row[offset];
-
-    size_t k = 0;
-    for (size_t q = offset + 1; q < w; ++q) {
-        // Skip parabolas at infinite heights (essentially non-existant parabolas)
-        if (isinf(img_row[q])) continue;
+bool dist_transform_2d_brute(float* img, size_t w, size_t h, struct df_control* control) {
+    // gather sites up front so each pixel only visits those
+    size_t n_sites = 0;
+    for (size_t i = 0; i < w * h; ++i) n_sites += img[i] == 0.f;
 
-        // Calculate intersection of current parabola and next candidate
-        float s = parabola_intersect(img_row, v[k], q);
+    size_t* sites = malloc(sizeof(size_t) * (n_sites > 0 ? n_sites : 1));
+    n_sites = 0;
+    for (size_t i = 0; i < w * h; ++i) {
+        if (img[i] == 0.f) sites[n_sites++] = i;
+    }
 
-        // If this intersection comes before current left bound, we must back up and change the necessary break point
-        // Skip for k == 0 because there is no left bound to look back on (it is at -infinity)
-        while (k > 0 && s <= z[k - 1]) {
-            --k;
-            s = parabola_intersect(img_row, v[k], q);
+    ptrdiff_t y;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (y = 0; y < (ptrdiff_t)(h); ++y) {
+        if (df_cancelled(control)) continue;
+        for (size_t x = 0; x < w; ++x) {
+            float best = INFINITY;
+            for (size_t s = 0; s < n_sites; ++s) {
+                float dx = (float)x - (float)(sites[s] % w);
+                float dy = (float)y - (float)(sites[s] / w);
+                float d_2 = dx * dx + dy * dy;
+                best = d_2 < best ? d_2 : best;
+            }
+            img[(size_t)y * w + x] = sqrtf(best);
         }
-        // Once we found a suitable break point, update the structure
-        // Right bound of current parabola is intersection
-        z[k] = s;
-        ++k;
-        // Horizontal position of next parabola is vertex
-        v[k] = q;
-        // Vertical position of next parabola
-        h[k] = img_row[q];
+        df_progress(control, 2 * w);
     }
 
-    // Part 2: Populate img_row using lower envelope
-    size_t j = 0;
-    for (size_t q = 0; q < w; ++q) {
-        // Seek break point past q
-        while (j < k && z[j] < (float)q) ++j;
-
-        // Set height at current position (q) along output to lower envelope
-        size_t v_j = v[j];
-        float displacement = (float)q - (float)v_j;
-
-        // Output transposed
-        size_t tpose_idx = y + w * q;
-        img_tpose_out[tpose_idx] = displacement * displacement + h[j];
+    free(sites);
+    return !df_cancelled(control);
+}
 
-        if (do_sqrt) img_tpose_out[tpose_idx] = sqrtf(img_tpose_out[tpose_idx]);
+const struct df_engine df_engines[] = {
+    {"fh", "Felzenszwalb/Huttenlocher lower envelope of parabolas, exact", MT_L2, true, 0, dist_transform_2d,
+     dist_transform_2d_dual},
+    {"fh-u32", "Felzenszwalb/Huttenlocher with 32-bit integers between the passes, exact", MT_L2, true, 0,
+     dist_transform_2d_u32, dist_transform_2d_dual_u32},
+    {"fh-u16", "Felzenszwalb/Huttenlocher with 16-bit integers between the passes, exact below 256", MT_L2, false, 0,
+     dist_transform_2d_u16, dist_transform_2d_dual_u16},
+    {"fh-f16", "Felzenszwalb/Huttenlocher with half floats between the passes, approximate below 256", MT_L2, false, 0,
+     dist_transform_2d_f16, dist_transform_2d_dual_f16},
+    {"meijster", "Meijster/Roerdink/Hesselink column sweeps and integer envelope, exact", MT_L2, true, 0,
+     dist_transform_2d_meijster, NULL},
+    {"chamfer-3-4", "two pass 3-4 chamfer, approximate", MT_L2, false, 0, dist_transform_2d_chamfer_3_4, NULL},
+    {"chamfer-5-7-11", "two pass 5-7-11 chamfer, approximate", MT_L2, false, 0, dist_transform_2d_chamfer_5_7_11, NULL},
+    {"8ssedt", "two pass 8-point sequential signed euclidean distance transform, approximate", MT_L2, false, 0,
+     dist_transform_2d_8ssedt, NULL},
+    {"brute", "brute force over all sites, exact reference for small images", MT_L2, true, 128 * 128,
+     dist_transform_2d_brute, NULL},
+    {"l1", "manhattan distance by scans along rows and columns, exact", MT_L1, true, 0, dist_transform_2d_l1,
+     dist_transform_2d_dual_l1},
+    {"linf", "chebyshev distance by scans along rows and integer envelopes along columns, exact", MT_LINF, true, 0,
+     dist_transform_2d_linf, dist_transform_2d_dual_linf},
+};
+
+const size_t df_num_engines = sizeof(df_engines) / sizeof(df_engines[0]);
+
+const struct df_engine* df_find_engine(const char* name) {
+    for (size_t i = 0; i < df_num_engines; ++i) {
+        if (strcmp(df_engines[i].name, name) == 0) return &df_engines[i];
     }
+    return NULL;
 }
 
-// Compute distance transform along x-axis of image using buffers passed in
-// img must be at least w*h floats large
-// Writes back to img_out in transpose which must be h*w floats large
-static void dist_transform_axis(float* restrict img, size_t w, size_t h, float* restrict img_tpose_out, bool do_sqrt) {
-#pragma omp parallel
-    {
-        ptrdiff_t y;
-        // Verticess buffer
-        size_t* v = malloc(sizeof(size_t) * (size_t)(w));
-        // Vertex height buffer
-        float* p = malloc(sizeof(float) * (size_t)(w));
-        // Break point buffer
-        float* z = malloc(sizeof(float) * (size_t)(w - 1));
-
-#pragma omp for schedule(static)
-        for (y = 0; y < (ptrdiff_t)(h); ++y) {
-            float* img_slice = img + ((size_t)y * w);
-            dist_transform_1d(img_slice, w, (size_t)y, v, p, z, img_tpose_out, do_sqrt);
-        }
-
-        free(z);
-        free(p);
-        free(v);
+const struct df_engine* df_metric_engine(enum METRIC metric) {
+    for (size_t i = 0; i < df_num_engines; ++i) {
+        if (df_engines[i].metric == metric) return &df_engines[i];
     }
+    return NULL;
 }
 
-void dist_transform_2d(float* img, size_t w, size_t h) {
-    // compute 1d for all rows
-    float* img_tpose = malloc(w * h * sizeof(float));
-
-    // compute distance transform and store transposed into img_tpose
-    dist_transform_axis(img, w, h, img_tpose, false);
-
-    // now do pass on transpose and store back into original image
-    dist_transform_axis(img_tpose, h, w, img, true);
-
-    free(img_tpose);
+enum METRIC read_metric(const char* string) {
+    const char* metric_table[] = {"l2", "l1", "linf"};
+    size_t n_metrics = sizeof(metric_table) / sizeof(const char*);
+    for (size_t metric = 0; metric < n_metrics; ++metric) {
+        if (strcmp(string, metric_table[metric]) == 0) return (enum METRIC)metric;
+    }
+    return MT_NONE;
 }
@@ -0,0 +1,103 @@
+#include "df.h"
+
+#include <cstdint>
+
+#include "df_core.hpp"
+
+// The Felzenszwalb/Huttenlocher entry points of df.h, as instantiations of the kernels in df_core.hpp
+
+using df_core::chebyshev;
+using df_core::euclidean;
+using df_core::half;
+using df_core::manhattan;
+using df_core::root;
+using df_core::squared;
+
+bool dist_transform_binary_rows(const float* img, size_t w, size_t h, float* img_tpose_out,
+                                struct df_control* control) {
+    return df_core::binary_rows(img, w, h, img_tpose_out, control);
+}
+
+bool dist_transform_axis(float* img, size_t w, size_t h, float* img_tpose_out, bool do_sqrt,
+                         struct df_control* control) {
+    // the epilogue is chosen once here rather than per pixel
+    return do_sqrt ? df_core::axis<float, size_t, euclidean, root>(img, w, h, img_tpose_out, control)
+                   : df_core::axis<float, size_t, euclidean, squared>(img, w, h, img_tpose_out, control);
+}
+
+bool dist_transform_2d(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::transform_2d<float, size_t>(img, w, h, control);
+}
+
+bool dist_transform_binary_rows_dual(const bool* mask, size_t w, size_t h, float* pair_tpose_out,
+                                     struct df_control* control) {
+    return df_core::binary_rows_dual(mask, w, h, pair_tpose_out, control);
+}
+
+bool dist_transform_axis_dual(const float* img_pair, size_t w, size_t h, float* img_a_tpose_out, float* img_b_tpose_out,
+                              bool do_sqrt, struct df_control* control) {
+    return do_sqrt ? df_core::axis_dual<float, size_t, euclidean, root>(img_pair, w, h, img_a_tpose_out,
+                                                                        img_b_tpose_out, control)
+                   : df_core::axis_dual<float, size_t, euclidean, squared>(img_pair, w, h, img_a_tpose_out,
+                                                                           img_b_tpose_out, control);
+}
+
+bool dist_transform_2d_dual(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                            struct df_control* control) {
+    return df_core::transform_2d_dual<float, size_t>(mask, inside_out, outside_out, w, h, control);
+}
+
+bool dist_transform_binary_columns_dual(const bool* mask, size_t w, size_t h, float* pair_out,
+                                        struct df_control* control) {
+    return df_core::binary_columns_dual(mask, w, h, pair_out, control);
+}
+
+bool dist_transform_rows_dual(const float* img_pair, size_t w, size_t y0, size_t y1, float* img_a_out,
+                              float* img_b_out, struct df_control* control) {
+    return df_core::rows_dual<float, size_t, euclidean, root>(img_pair, w, y0, y1, img_a_out, img_b_out, control);
+}
+
+bool dist_transform_2d_f16(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::transform_2d<half, uint32_t>(img, w, h, control);
+}
+
+bool dist_transform_2d_dual_f16(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control) {
+    return df_core::transform_2d_dual<half, uint32_t>(mask, inside_out, outside_out, w, h, control);
+}
+
+bool dist_transform_2d_u16(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::transform_2d<uint16_t, uint32_t>(img, w, h, control);
+}
+
+bool dist_transform_2d_dual_u16(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control) {
+    return df_core::transform_2d_dual<uint16_t, uint32_t>(mask, inside_out, outside_out, w, h, control);
+}
+
+bool dist_transform_2d_u32(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::transform_2d<uint32_t, uint32_t>(img, w, h, control);
+}
+
+bool dist_transform_2d_dual_u32(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control) {
+    return df_core::transform_2d_dual<uint32_t, uint32_t>(mask, inside_out, outside_out, w, h, control);
+}
+
+bool dist_transform_2d_l1(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::separable_2d<manhattan>(img, w, h, control);
+}
+
+bool dist_transform_2d_dual_l1(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                               struct df_control* control) {
+    return df_core::separable_2d_dual<manhattan>(mask, inside_out, outside_out, w, h, control);
+}
+
+bool dist_transform_2d_linf(float* img, size_t w, size_t h, struct df_control* control) {
+    return df_core::separable_2d<chebyshev>(img, w, h, control);
+}
+
+bool dist_transform_2d_dual_linf(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                 struct df_control* control) {
+    return df_core::separable_2d_dual<chebyshev>(mask, inside_out, outside_out, w, h, control);
+}
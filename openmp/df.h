@@ -1,8 +1,151 @@
 #ifndef DF_H
 #define DF_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
-void dist_transform_2d(float* img, size_t w, size_t h);
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Optional control over running transforms, shared by all transforms of one job. Every transform and pass takes a
+// pointer to one, or NULL for none, which costs a pointer test per block of rows.
+#ifdef __cplusplus
+// C11 atomics have no C++17 counterpart, the kernels of df_core.hpp only hand the pointer to the functions below
+struct df_control;
+#else
+struct df_control {
+    // set from any thread to stop the job, transforms check it per block of rows and then return false promptly,
+    // leaving their output undefined
+    atomic_bool cancel;
+    // if not NULL, called with the fraction of the job done in steps of 0.001, from a transform's threads but never
+    // concurrently
+    void (*progress)(void* context, double fraction);
+    // if not NULL, called at every check of cancel by the checking thread, and may block there to let more urgent work
+    // run, which preempts the transform at the granularity of a block of rows. Left NULL by df_control_init.
+    void (*pause)(void* context);
+    void* context;
+    // maintained by the transforms: units of work done, last reported permille and units in the whole job
+    atomic_size_t done;
+    atomic_size_t reported;
+    size_t total;
+};
+#endif
+
+// Sets up control with no cancel request, progress may be NULL
+void df_control_init(struct df_control* control, void (*progress)(void* context, double fraction), void* context);
+// Starts a job of total units on control (NULL is allowed), leaving a cancel request in place
+void df_control_start(struct df_control* control, size_t total);
+// Units of work of one 2d transform of a w*h field, a dual transform is twice that
+size_t df_work(size_t w, size_t h);
+// Whether control asks to stop, after pausing if it asks for that
+bool df_cancelled(struct df_control* control);
+// Records finished units of work and reports progress
+void df_progress(struct df_control* control, size_t units);
+
+// what a distance measures: euclidean, manhattan (|dx| + |dy|) or chebyshev (max(|dx|, |dy|))
+enum METRIC { MT_NONE = -1, MT_L2, MT_L1, MT_LINF };
+
+// All 2d transforms take img as w*h floats which are 0 at sites and INFINITY elsewhere, and replace each value with the
+// distance to the nearest site (INFINITY if there are no sites), euclidean unless the transform says otherwise. They
+// return false if cancelled.
+typedef bool (*df_transform_fn)(float* img, size_t w, size_t h, struct df_control* control);
+// Fused transform of both fields of a binary mask: inside_out gets the distance to the nearest true pixel, outside_out
+// the distance to the nearest false pixel, each w*h floats
+typedef bool (*df_dual_fn)(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                           struct df_control* control);
+
+// Felzenszwalb/Huttenlocher separable transform
+bool dist_transform_2d(float* img, size_t w, size_t h, struct df_control* control);
+// Passes of dist_transform_2d, exposed for per-pass measurements. Both transform the w-long rows of img and write them
+// transposed into img_tpose_out (h-long rows).
+// binary rows -- first pass, img must be binary (0 or INFINITY), writes squared distances along rows
+// axis -- second pass, general lower envelope of img's values as parabola heights, squared unless do_sqrt
+bool dist_transform_binary_rows(const float* img, size_t w, size_t h, float* img_tpose_out, struct df_control* control);
+bool dist_transform_axis(float* img, size_t w, size_t h, float* img_tpose_out, bool do_sqrt,
+                         struct df_control* control);
+// Felzenszwalb/Huttenlocher transform of both fields of mask, reading it once in the row pass
+bool dist_transform_2d_dual(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                            struct df_control* control);
+// Passes of dist_transform_2d_dual, like the single field passes but on pairs of floats, inside first
+// binary rows dual -- first pass from mask, writes squared distances of both fields interleaved
+// axis dual -- second pass over interleaved pairs, writes each field transposed into its own image
+bool dist_transform_binary_rows_dual(const bool* mask, size_t w, size_t h, float* pair_tpose_out,
+                                     struct df_control* control);
+bool dist_transform_axis_dual(const float* img_pair, size_t w, size_t h, float* img_a_tpose_out, float* img_b_tpose_out,
+                              bool do_sqrt, struct df_control* control);
+// The same passes in the opposite order, so that output rows complete in order for streaming
+// binary columns dual -- first pass from mask, writes squared distances of both fields along columns interleaved,
+// without transposing
+// rows dual -- second pass over rows [y0,y1) of interleaved pairs, writes the euclidean distances of each field into
+// its own (y1-y0)*w band
+bool dist_transform_binary_columns_dual(const bool* mask, size_t w, size_t h, float* pair_out,
+                                        struct df_control* control);
+bool dist_transform_rows_dual(const float* img_pair, size_t w, size_t y0, size_t y1, float* img_a_out,
+                              float* img_b_out, struct df_control* control);
+// dist_transform_2d and dist_transform_2d_dual keeping the squared distances between the passes as other types, 16 bits
+// halve the memory traffic of the intermediate image. Sites more than 255 pixels away along a row do not fit 16 bits,
+// so u16 is exact where the distance is below 256 and at least 256 elsewhere, f16 the same to within 0.03%.
+bool dist_transform_2d_u32(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_dual_u32(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control);
+bool dist_transform_2d_u16(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_dual_u16(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control);
+bool dist_transform_2d_f16(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_dual_f16(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                struct df_control* control);
+// Manhattan (l1) and chebyshev (linf) distances, exactly separable into distances along rows followed by a pass along
+// columns, both in place without transposing: scans for l1, a linear integer envelope of cones for linf
+bool dist_transform_2d_l1(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_dual_l1(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                               struct df_control* control);
+bool dist_transform_2d_linf(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_dual_linf(const bool* mask, float* inside_out, float* outside_out, size_t w, size_t h,
+                                 struct df_control* control);
+// Meijster/Roerdink/Hesselink transform, integer column sweeps followed by an integer envelope along rows
+bool dist_transform_2d_meijster(float* img, size_t w, size_t h, struct df_control* control);
+// Approximate transforms for previews, single threaded per field. Maximum error against dist_transform_2d, in pixels
+// at distance d: chamfer 3-4 up to about 0.06 * d, chamfer 5-7-11 up to about 0.02 * d, 8SSEDT below 0.1 pixels
+// except for rare configurations of sites
+bool dist_transform_2d_chamfer_3_4(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_chamfer_5_7_11(float* img, size_t w, size_t h, struct df_control* control);
+bool dist_transform_2d_8ssedt(float* img, size_t w, size_t h, struct df_control* control);
+// Brute force search over every site, only meant as a reference on small images
+bool dist_transform_2d_brute(float* img, size_t w, size_t h, struct df_control* control);
+
+struct df_engine {
+    const char* name;
+    const char* description;
+    // distances the engine computes
+    enum METRIC metric;
+    // whether the engine produces exact distances of its metric
+    bool exact;
+    // largest image (in pixels) the engine is practical for, 0 if unbounded
+    size_t max_pixels;
+    df_transform_fn transform_2d;
+    // optional fused transform of both fields, NULL if the engine has none
+    df_dual_fn transform_2d_dual;
+};
+
+// Registry of all engines, the first one is the default and the reference for accuracy comparisons
+extern const struct df_engine df_engines[];
+extern const size_t df_num_engines;
+
+// Looks up an engine by name, NULL if there is none
+const struct df_engine* df_find_engine(const char* name);
+// The first engine of metric in the registry, its default
+const struct df_engine* df_metric_engine(enum METRIC metric);
+
+// reads l2, l1 or linf
+enum METRIC read_metric(const char* string);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
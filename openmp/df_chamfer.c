@@ -0,0 +1,156 @@
+#include "df.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Approximate raster scan transforms for previews. Each pass first relaxes a whole row against the rows already
+// finished (no dependency along the row, so compilers vectorize it), then sweeps the row serially for the in-row
+// neighbor. This is equivalent to the classic pixel-by-pixel raster scan.
+// Reference: Distance Transformations in Digital Images (G. Borgefors)
+// Reference: Euclidean Distance Mapping (P. Danielsson), of which 8SSEDT is the 8-neighbor two pass variant
+
+// chamfer weights in pixels: axial step, diagonal step, knight step (INFINITY when the mask has none)
+struct chamfer_mask {
+    float a;
+    float b;
+    float c;
+};
+
+static float min2(float x, float y) { return x < y ? x : y; }
+
+// value of row at x, INFINITY outside the image
+static float at(const float* row, ptrdiff_t x, size_t w) {
+    return (row == NULL || x < 0 || x >= (ptrdiff_t)w) ? INFINITY : row[x];
+}
+
+// relaxes pixel x of dst against near and far, with bounds checks
+static void chamfer_px(float* dst, const float* near, const float* far, size_t w, ptrdiff_t x, struct chamfer_mask m) {
+    float d = min2(dst[x], at(near, x, w) + m.a);
+    d = min2(d, min2(at(near, x - 1, w), at(near, x + 1, w)) + m.b);
+    float knight = min2(min2(at(near, x - 2, w), at(near, x + 2, w)), min2(at(far, x - 1, w), at(far, x + 1, w)));
+    dst[x] = min2(d, knight + m.c);
+}
+
+// relaxes dst against the neighbors in the row one step away (near) and two steps away (far, may be NULL)
+static void chamfer_rows(float* restrict dst, const float* restrict near, const float* restrict far, size_t w,
+                         struct chamfer_mask m) {
+    // pixels within two of the border need bounds checks
+    size_t interior_end = w > 2 ? w - 2 : 0;
+    for (size_t x = 0; x < w && x < 2; ++x) chamfer_px(dst, near, far, w, (ptrdiff_t)x, m);
+    for (size_t x = interior_end > 2 ? interior_end : 2; x < w; ++x) chamfer_px(dst, near, far, w, (ptrdiff_t)x, m);
+
+    // interior, branch free
+    for (size_t x = 2; x < interior_end; ++x) {
+        float d = min2(dst[x], near[x] + m.a);
+        dst[x] = min2(d, min2(near[x - 1], near[x + 1]) + m.b);
+    }
+    if (isinf(m.c)) return;
+    if (far != NULL) {
+        for (size_t x = 2; x < interior_end; ++x) {
+            float d = min2(min2(near[x - 2], near[x + 2]), min2(far[x - 1], far[x + 1]));
+            dst[x] = min2(dst[x], d + m.c);
+        }
+    } else {
+        for (size_t x = 2; x < interior_end; ++x) dst[x] = min2(dst[x], min2(near[x - 2], near[x + 2]) + m.c);
+    }
+}
+
+static bool chamfer_2d(float* img, size_t w, size_t h, struct chamfer_mask m, struct df_control* control) {
+    // forward pass, top to bottom then left to right within the row
+    for (size_t y = 0; y < h; ++y) {
+        if (df_cancelled(control)) return false;
+        float* row = img + y * w;
+        if (y > 0) chamfer_rows(row, row - w, y > 1 ? row - 2 * w : NULL, w, m);
+        for (size_t x = 1; x < w; ++x) row[x] = min2(row[x], row[x - 1] + m.a);
+        df_progress(control, w);
+    }
+
+    // backward pass, bottom to top then right to left within the row
+    for (size_t y = h; y-- > 0;) {
+        if (df_cancelled(control)) return false;
+        float* row = img + y * w;
+        if (y + 1 < h) chamfer_rows(row, row + w, y + 2 < h ? row + 2 * w : NULL, w, m);
+        for (size_t x = w - 1; x-- > 0;) row[x] = min2(row[x], row[x + 1] + m.a);
+        df_progress(control, w);
+    }
+    return true;
+}
+
+bool dist_transform_2d_chamfer_3_4(float* img, size_t w, size_t h, struct df_control* control) {
+    struct chamfer_mask m = {1.f, 4.f / 3.f, INFINITY};
+    return chamfer_2d(img, w, h, m, control);
+}
+
+bool dist_transform_2d_chamfer_5_7_11(float* img, size_t w, size_t h, struct df_control* control) {
+    struct chamfer_mask m = {1.f, 7.f / 5.f, 11.f / 5.f};
+    return chamfer_2d(img, w, h, m, control);
+}
+
+// 8SSEDT keeps the offset to the nearest site found so far per pixel and propagates offsets instead of distances.
+// Offsets are floats so that rows relax with plain vector arithmetic, INFINITY offsets mark pixels without a site.
+
+// takes the candidate offset (cx, cy) at index x of (ox, oy) if it is closer
+#define SSEDT_TAKE(x, cx, cy)                                                                                          \
+    {                                                                                                                  \
+        float cand_x = (cx);                                                                                           \
+        float cand_y = (cy);                                                                                           \
+        float cand_d = cand_x * cand_x + cand_y * cand_y;                                                              \
+        float cur_d = ox[x] * ox[x] + oy[x] * oy[x];                                                                   \
+        bool closer = cand_d < cur_d;                                                                                  \
+        ox[x] = closer ? cand_x : ox[x];                                                                               \
+        oy[x] = closer ? cand_y : oy[x];                                                                               \
+    }
+
+// relaxes row (ox, oy) against the finished row (nx, ny) lying dy rows away
+static void ssedt_rows(float* restrict ox, float* restrict oy, const float* restrict nx, const float* restrict ny,
+                       size_t w, float dy) {
+    SSEDT_TAKE(0, nx[0], ny[0] + dy);
+    if (w > 1) SSEDT_TAKE(0, nx[1] + 1.f, ny[1] + dy);
+    for (size_t x = 1; x + 1 < w; ++x) {
+        SSEDT_TAKE(x, nx[x], ny[x] + dy);
+        SSEDT_TAKE(x, nx[x - 1] - 1.f, ny[x - 1] + dy);
+        SSEDT_TAKE(x, nx[x + 1] + 1.f, ny[x + 1] + dy);
+    }
+    if (w > 1) {
+        SSEDT_TAKE(w - 1, nx[w - 1], ny[w - 1] + dy);
+        SSEDT_TAKE(w - 1, nx[w - 2] - 1.f, ny[w - 2] + dy);
+    }
+}
+
+// sweeps the row left to right then right to left against the in-row neighbor
+static void ssedt_sweep(float* restrict ox, float* restrict oy, size_t w) {
+    for (size_t x = 1; x < w; ++x) SSEDT_TAKE(x, ox[x - 1] - 1.f, oy[x - 1]);
+    for (size_t x = w - 1; x-- > 0;) SSEDT_TAKE(x, ox[x + 1] + 1.f, oy[x + 1]);
+}
+
+#undef SSEDT_TAKE
+
+bool dist_transform_2d_8ssedt(float* img, size_t w, size_t h, struct df_control* control) {
+    float* ox = malloc(sizeof(float) * w * h);
+    float* oy = malloc(sizeof(float) * w * h);
+
+    // offsets point from a pixel towards its nearest site, so neighbor offsets are shifted by the step taken
+    for (size_t i = 0; i < w * h; ++i) {
+        ox[i] = img[i] == 0.f ? 0.f : INFINITY;
+        oy[i] = ox[i];
+    }
+
+    for (size_t y = 0; y < h && !df_cancelled(control); ++y) {
+        if (y > 0) ssedt_rows(ox + y * w, oy + y * w, ox + (y - 1) * w, oy + (y - 1) * w, w, -1.f);
+        ssedt_sweep(ox + y * w, oy + y * w, w);
+        df_progress(control, w);
+    }
+    for (size_t y = h; y-- > 0 && !df_cancelled(control);) {
+        if (y + 1 < h) ssedt_rows(ox + y * w, oy + y * w, ox + (y + 1) * w, oy + (y + 1) * w, w, 1.f);
+        ssedt_sweep(ox + y * w, oy + y * w, w);
+        df_progress(control, w);
+    }
+
+    bool ok = !df_cancelled(control);
+    if (ok) {
+        for (size_t i = 0; i < w * h; ++i) img[i] = sqrtf(ox[i] * ox[i] + oy[i] * oy[i]);
+    }
+
+    free(oy);
+    free(ox);
+    return ok;
+}
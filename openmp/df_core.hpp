@@ -0,0 +1,692 @@
+#ifndef DF_CORE_HPP
+#define DF_CORE_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "df.h"
+#include "trace.h"
+
+// Felzenszwalb/Huttenlocher separable transform, specialized at compile time by
+// storage -- type of the squared distances kept between the two passes (float, half, uint16_t or uint32_t)
+// index -- type of the envelope's vertex positions along a row
+// metric -- parabola shape of the envelope
+// epilogue -- applied to every output value
+// so that the inner loops test nothing that is known before the transform starts. The C entry points in df.h are
+// instantiations of these, see df.cpp.
+namespace df_core {
+
+// rows scanned together by the binary row passes, the innermost loops run across them
+constexpr std::size_t binary_block = 16;
+// columns scanned together by binary_columns_dual, each scan step covers a contiguous run of a row
+constexpr std::size_t column_block = 256;
+
+// IEEE 754 binary16, converted in software so that no instruction set extension is needed
+struct half {
+    std::uint16_t bits;
+};
+
+inline half to_half(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+    std::uint32_t magnitude = bits & 0x7fffffffu;
+
+    // infinity and nan keep their class, values that round past 65504 become infinity
+    if (magnitude >= 0x7f800000u) return {static_cast<std::uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u) << 9)};
+    if (magnitude >= 0x477ff000u) return {static_cast<std::uint16_t>(sign | 0x7c00u)};
+    // below 2^-14 the result is subnormal, in units of 2^-24
+    if (magnitude < 0x38800000u) {
+        return {static_cast<std::uint16_t>(sign | std::lrint(std::fabs(value) * 16777216.f))};
+    }
+    // rebias the exponent and round the mantissa to nearest even
+    std::uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13) & 1u);
+    return {static_cast<std::uint16_t>(sign | ((rounded - 0x38000000u) >> 13))};
+}
+
+inline float from_half(half value) {
+    std::uint32_t sign = static_cast<std::uint32_t>(value.bits & 0x8000u) << 16;
+    std::uint32_t exponent = (value.bits >> 10) & 0x1fu;
+    std::uint32_t mantissa = value.bits & 0x3ffu;
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign != 0 ? -magnitude : magnitude;
+    }
+
+    std::uint32_t bits = sign | (exponent == 0x1fu ? 0x7f800000u : (exponent + 112) << 23) | (mantissa << 13);
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Storage policies. The row passes count distances in scan_type, keep them unsquared in the output between their
+// forward and backward scans, and store them squared. The envelope pass loads the squared distances as float heights,
+// INFINITY where a row has no site in reach of the type.
+template <typename T>
+struct storage;
+
+template <>
+struct storage<float> {
+    using scan_type = float;
+    static constexpr scan_type scan_infinity() { return std::numeric_limits<float>::infinity(); }
+    static scan_type scan_next(scan_type d) { return d + 1.f; }
+    static float store_distance(scan_type d) { return d; }
+    static scan_type load_distance(float stored) { return stored; }
+    static float store_squared(scan_type d) { return d * d; }
+    static float load(float stored) { return stored; }
+};
+
+// relative error of 2^-11 on squared distances, and no site in reach beyond 255 pixels along a row
+template <>
+struct storage<half> {
+    using scan_type = float;
+    static constexpr scan_type scan_infinity() { return std::numeric_limits<float>::infinity(); }
+    static scan_type scan_next(scan_type d) { return d + 1.f; }
+    static half store_distance(scan_type d) { return to_half(d); }
+    static scan_type load_distance(half stored) { return from_half(stored); }
+    static half store_squared(scan_type d) { return to_half(d * d); }
+    static float load(half stored) { return from_half(stored); }
+};
+
+// exact, with no site in reach beyond 255 pixels along a row, the largest value stands for none
+template <>
+struct storage<std::uint16_t> {
+    using scan_type = std::uint32_t;
+    static constexpr std::uint16_t none = std::numeric_limits<std::uint16_t>::max();
+    static constexpr scan_type scan_infinity() { return std::numeric_limits<std::uint32_t>::max(); }
+    static scan_type scan_next(scan_type d) { return d == scan_infinity() ? d : d + 1; }
+    static std::uint16_t store_distance(scan_type d) { return d < none ? static_cast<std::uint16_t>(d) : none; }
+    static scan_type load_distance(std::uint16_t stored) { return stored == none ? scan_infinity() : stored; }
+    static std::uint16_t store_squared(scan_type d) { return d < 256 ? static_cast<std::uint16_t>(d * d) : none; }
+    static float load(std::uint16_t stored) {
+        return stored == none ? std::numeric_limits<float>::infinity() : static_cast<float>(stored);
+    }
+};
+
+// exact for rows up to 65535 pixels, the largest value stands for none
+template <>
+struct storage<std::uint32_t> {
+    using scan_type = std::uint32_t;
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+    static constexpr scan_type scan_infinity() { return none; }
+    static scan_type scan_next(scan_type d) { return d == none ? d : d + 1; }
+    static std::uint32_t store_distance(scan_type d) { return d; }
+    static scan_type load_distance(std::uint32_t stored) { return stored; }
+    static std::uint32_t store_squared(scan_type d) { return d < 65536 ? d * d : none; }
+    static float load(std::uint32_t stored) {
+        return stored == none ? std::numeric_limits<float>::infinity() : static_cast<float>(stored);
+    }
+};
+
+// Metric policies: separator of two parabolas rooted at p and q with heights f_p and f_q, and the value of a parabola
+// at a displacement from its root
+struct euclidean {
+    static float separator(float f_p, float f_q, float p, float q) {
+        return ((f_q - f_p) + ((q * q) - (p * p))) / (2 * (q - p));
+    }
+    static float distance(float displacement, float height) { return displacement * displacement + height; }
+};
+
+// Epilogue policies, applied to every value written by the envelope pass
+struct squared {
+    static float apply(float value) { return value; }
+};
+
+struct root {
+    static float apply(float value) { return std::sqrt(value); }
+};
+
+// Compute the lower envelope of one row of parabola heights and write it out
+// Reference: Distance Transforms of Sampled Functions (P. Felzenszwalb, D. Huttenlocher):
+//      http://cs.brown.edu/people/pfelzens/dt/
+// row -- w parabola heights, INFINITY for none
+// y -- current y for transpose
+// tpose_w -- row length of out, which is the number of rows being transformed
+// v -- vertices buffer, sized w
+// h -- vertex height buffer, sized w
+// z -- break point buffer, associates z[n] with v[n]'s right bound, sized w-1
+// out -- output buffer, populated in transpose, at minimum w * tpose_w
+template <typename Index, typename Metric, typename Epilogue>
+void transform_1d(const float* __restrict row, Index w, std::size_t y, std::size_t tpose_w, Index* __restrict v,
+                  float* __restrict h, float* __restrict z, float* __restrict out) {
+    // Single-cell is already complete
+    if (w <= 1) {
+        out[y] = Epilogue::apply(row[0]);
+        return;
+    }
+
+    // Part 1: Compute lower envelope as a set of break points and vertices
+    // Start at the first non-infinity parabola
+    Index offset = 0;
+    while (offset < w && std::isinf(row[offset])) ++offset;
+
+    // If lower envelope is all at infinity, we have an empty row, this is complete as far as we care
+    if (offset == w) {
+        // Because we're transposing on writeback, we need to fill empty rows
+        for (Index i = 0; i < w; ++i) out[y + tpose_w * i] = std::numeric_limits<float>::infinity();
+        return;
+    }
+
+    // First vertex is that of the first parabola
+    v[0] = offset;
+    h[0] = row[offset];
+
+    Index k = 0;
+    for (Index q = offset + 1; q < w; ++q) {
+        // Skip parabolas at infinite heights (essentially non-existant parabolas)
+        if (std::isinf(row[q])) continue;
+
+        // Calculate intersection of current parabola and next candidate
+        float s = Metric::separator(row[v[k]], row[q], static_cast<float>(v[k]), static_cast<float>(q));
+
+        // If this intersection comes before current left bound, we must back up and change the necessary break point
+        // Skip for k == 0 because there is no left bound to look back on (it is at -infinity)
+        while (k > 0 && s <= z[k - 1]) {
+            --k;
+            s = Metric::separator(row[v[k]], row[q], static_cast<float>(v[k]), static_cast<float>(q));
+        }
+        // Once we found a suitable break point, update the structure
+        // Right bound of current parabola is intersection
+        z[k] = s;
+        ++k;
+        // Horizontal position of next parabola is vertex
+        v[k] = q;
+        // Vertical position of next parabola
+        h[k] = row[q];
+    }
+
+    // Part 2: Populate the output using lower envelope
+    Index j = 0;
+    for (Index q = 0; q < w; ++q) {
+        // Seek break point past q
+        while (j < k && z[j] < static_cast<float>(q)) ++j;
+
+        // Set height at current position (q) along output to lower envelope, transposed
+        float displacement = static_cast<float>(q) - static_cast<float>(v[j]);
+        out[y + tpose_w * q] = Epilogue::apply(Metric::distance(displacement, h[j]));
+    }
+}
+
+// buffers of one thread's envelopes along rows of w pixels, for one or two fields
+template <typename Index>
+struct envelope_buffers {
+    float* row_a;
+    float* row_b;
+    Index* v;
+    float* h;
+    float* z;
+
+    envelope_buffers(std::size_t w, bool two_rows)
+        : row_a(static_cast<float*>(std::malloc(sizeof(float) * w))),
+          row_b(two_rows ? static_cast<float*>(std::malloc(sizeof(float) * w)) : nullptr),
+          v(static_cast<Index*>(std::malloc(sizeof(Index) * w))),
+          h(static_cast<float*>(std::malloc(sizeof(float) * w))),
+          z(static_cast<float*>(std::malloc(sizeof(float) * (w - 1)))) {}
+    envelope_buffers(const envelope_buffers&) = delete;
+    envelope_buffers& operator=(const envelope_buffers&) = delete;
+    ~envelope_buffers() {
+        std::free(z);
+        std::free(h);
+        std::free(v);
+        std::free(row_b);
+        std::free(row_a);
+    }
+};
+
+// First pass: img must be binary (0 or INFINITY), writes squared distances along rows transposed into tpose_out
+template <typename Storage>
+bool binary_rows(const float* __restrict img, std::size_t w, std::size_t h, Storage* __restrict tpose_out,
+                 df_control* control) {
+    using policy = storage<Storage>;
+    using scan_type = typename policy::scan_type;
+    TRACE_BEGIN(region, "dist_transform_binary_rows");
+    std::ptrdiff_t block;
+#pragma omp parallel for schedule(static)
+    for (block = 0; block < static_cast<std::ptrdiff_t>((h + binary_block - 1) / binary_block); ++block) {
+        if (df_cancelled(control)) continue;
+        TRACE_BEGIN(chunk, "block");
+        std::size_t y0 = static_cast<std::size_t>(block) * binary_block;
+        std::size_t rows = h - y0 < binary_block ? h - y0 : binary_block;
+        const float* img_block = img + y0 * w;
+        // distance to the last site seen by the scan, per row of the block
+        scan_type d[binary_block];
+
+        // forward scan leaves the distance to the nearest site on the left
+        for (std::size_t b = 0; b < rows; ++b) d[b] = policy::scan_infinity();
+        for (std::size_t x = 0; x < w; ++x) {
+            Storage* out = tpose_out + x * h + y0;
+            for (std::size_t b = 0; b < rows; ++b) {
+                d[b] = img_block[b * w + x] == 0.f ? scan_type(0) : policy::scan_next(d[b]);
+                out[b] = policy::store_distance(d[b]);
+            }
+        }
+
+        // backward scan takes the nearer of both sides and squares it
+        for (std::size_t b = 0; b < rows; ++b) d[b] = policy::scan_infinity();
+        for (std::size_t x = w; x-- > 0;) {
+            Storage* out = tpose_out + x * h + y0;
+            for (std::size_t b = 0; b < rows; ++b) {
+                d[b] = img_block[b * w + x] == 0.f ? scan_type(0) : policy::scan_next(d[b]);
+                scan_type left = policy::load_distance(out[b]);
+                out[b] = policy::store_squared(d[b] < left ? d[b] : left);
+            }
+        }
+        df_progress(control, rows * w);
+        TRACE_END_INDEX(chunk, block);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+// Second pass: general lower envelope of img's values as parabola heights along its w-long rows, written transposed
+// into tpose_out
+template <typename Storage, typename Index, typename Metric, typename Epilogue>
+bool axis(const Storage* __restrict img, std::size_t w, std::size_t h, float* __restrict tpose_out,
+          df_control* control) {
+    TRACE_BEGIN(region, "dist_transform_axis");
+#pragma omp parallel
+    {
+        std::ptrdiff_t y;
+        envelope_buffers<Index> buffers(w, false);
+
+#pragma omp for schedule(static)
+        for (y = 0; y < static_cast<std::ptrdiff_t>(h); ++y) {
+            // once cancelled the remaining rows are skipped
+            if (df_cancelled(control)) continue;
+            TRACE_BEGIN(row, "row");
+            const Storage* img_row = img + static_cast<std::size_t>(y) * w;
+            // float rows are read in place, others converted first
+            const float* heights = buffers.row_a;
+            if constexpr (std::is_same_v<Storage, float>) {
+                heights = img_row;
+            } else {
+                for (std::size_t x = 0; x < w; ++x) buffers.row_a[x] = storage<Storage>::load(img_row[x]);
+            }
+            transform_1d<Index, Metric, Epilogue>(heights, static_cast<Index>(w), static_cast<std::size_t>(y), h,
+                                                  buffers.v, buffers.h, buffers.z, tpose_out);
+            df_progress(control, w);
+            TRACE_END_INDEX(row, y);
+        }
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+template <typename Storage, typename Index>
+bool transform_2d(float* img, std::size_t w, std::size_t h, df_control* control) {
+    // input is binary, so the first pass needs no envelope, store squared distances transposed into img_tpose
+    // then do pass on transpose and store back into original image
+    auto* img_tpose = static_cast<Storage*>(std::malloc(w * h * sizeof(Storage)));
+    bool ok = binary_rows(img, w, h, img_tpose, control) &&
+              axis<Storage, Index, euclidean, root>(img_tpose, h, w, img, control);
+
+    std::free(img_tpose);
+    return ok;
+}
+
+// First pass of both fields from mask, squared distances to the nearest true and false pixel interleaved
+template <typename Storage>
+bool binary_rows_dual(const bool* __restrict mask, std::size_t w, std::size_t h, Storage* __restrict pair_tpose_out,
+                      df_control* control) {
+    using policy = storage<Storage>;
+    using scan_type = typename policy::scan_type;
+    TRACE_BEGIN(region, "dist_transform_binary_rows_dual");
+    std::ptrdiff_t block;
+#pragma omp parallel for schedule(static)
+    for (block = 0; block < static_cast<std::ptrdiff_t>((h + binary_block - 1) / binary_block); ++block) {
+        if (df_cancelled(control)) continue;
+        TRACE_BEGIN(chunk, "block");
+        std::size_t y0 = static_cast<std::size_t>(block) * binary_block;
+        std::size_t rows = h - y0 < binary_block ? h - y0 : binary_block;
+        const bool* mask_block = mask + y0 * w;
+        // distance to the last true and false pixel seen by the scan, per row of the block
+        scan_type d_true[binary_block];
+        scan_type d_false[binary_block];
+
+        // forward scan, a pixel is a site of exactly one of the fields
+        for (std::size_t b = 0; b < rows; ++b) d_true[b] = d_false[b] = policy::scan_infinity();
+        for (std::size_t x = 0; x < w; ++x) {
+            Storage* out = pair_tpose_out + 2 * (x * h + y0);
+            for (std::size_t b = 0; b < rows; ++b) {
+                bool site = mask_block[b * w + x];
+                d_true[b] = site ? scan_type(0) : policy::scan_next(d_true[b]);
+                d_false[b] = site ? policy::scan_next(d_false[b]) : scan_type(0);
+                out[2 * b] = policy::store_distance(d_true[b]);
+                out[2 * b + 1] = policy::store_distance(d_false[b]);
+            }
+        }
+
+        // backward scan takes the nearer of both sides and squares it
+        for (std::size_t b = 0; b < rows; ++b) d_true[b] = d_false[b] = policy::scan_infinity();
+        for (std::size_t x = w; x-- > 0;) {
+            Storage* out = pair_tpose_out + 2 * (x * h + y0);
+            for (std::size_t b = 0; b < rows; ++b) {
+                bool site = mask_block[b * w + x];
+                d_true[b] = site ? scan_type(0) : policy::scan_next(d_true[b]);
+                d_false[b] = site ? policy::scan_next(d_false[b]) : scan_type(0);
+                scan_type left_true = policy::load_distance(out[2 * b]);
+                scan_type left_false = policy::load_distance(out[2 * b + 1]);
+                out[2 * b] = policy::store_squared(d_true[b] < left_true ? d_true[b] : left_true);
+                out[2 * b + 1] = policy::store_squared(d_false[b] < left_false ? d_false[b] : left_false);
+            }
+        }
+        df_progress(control, 2 * rows * w);
+        TRACE_END_INDEX(chunk, block);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+// Second pass over interleaved pairs, each field written transposed into its own image
+template <typename Storage, typename Index, typename Metric, typename Epilogue>
+bool axis_dual(const Storage* __restrict img_pair, std::size_t w, std::size_t h, float* __restrict img_a_tpose_out,
+               float* __restrict img_b_tpose_out, df_control* control) {
+    TRACE_BEGIN(region, "dist_transform_axis_dual");
+#pragma omp parallel
+    {
+        std::ptrdiff_t y;
+        // rows of both fields are split out of the interleaved input, the envelope buffers are shared by both
+        envelope_buffers<Index> buffers(w, true);
+
+#pragma omp for schedule(static)
+        for (y = 0; y < static_cast<std::ptrdiff_t>(h); ++y) {
+            if (df_cancelled(control)) continue;
+            TRACE_BEGIN(row, "row");
+            const Storage* pair_slice = img_pair + 2 * (static_cast<std::size_t>(y) * w);
+            for (std::size_t x = 0; x < w; ++x) {
+                buffers.row_a[x] = storage<Storage>::load(pair_slice[2 * x]);
+                buffers.row_b[x] = storage<Storage>::load(pair_slice[2 * x + 1]);
+            }
+            transform_1d<Index, Metric, Epilogue>(buffers.row_a, static_cast<Index>(w), static_cast<std::size_t>(y),
+                                                  h, buffers.v, buffers.h, buffers.z, img_a_tpose_out);
+            transform_1d<Index, Metric, Epilogue>(buffers.row_b, static_cast<Index>(w), static_cast<std::size_t>(y),
+                                                  h, buffers.v, buffers.h, buffers.z, img_b_tpose_out);
+            df_progress(control, 2 * w);
+            TRACE_END_INDEX(row, y);
+        }
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+template <typename Storage, typename Index>
+bool transform_2d_dual(const bool* mask, float* inside_out, float* outside_out, std::size_t w, std::size_t h,
+                       df_control* control) {
+    // both fields' row passes, interleaved per pixel so the column pass reads them as one stream
+    auto* pair_tpose = static_cast<Storage*>(std::malloc(2 * w * h * sizeof(Storage)));
+    bool ok = binary_rows_dual(mask, w, h, pair_tpose, control) &&
+              axis_dual<Storage, Index, euclidean, root>(pair_tpose, h, w, inside_out, outside_out, control);
+
+    std::free(pair_tpose);
+    return ok;
+}
+
+// First pass of the streaming order, along columns of mask without transposing
+template <typename Storage>
+bool binary_columns_dual(const bool* __restrict mask, std::size_t w, std::size_t h, Storage* __restrict pair_out,
+                         df_control* control) {
+    using policy = storage<Storage>;
+    using scan_type = typename policy::scan_type;
+    TRACE_BEGIN(region, "dist_transform_binary_columns_dual");
+    std::ptrdiff_t block;
+#pragma omp parallel for schedule(static)
+    for (block = 0; block < static_cast<std::ptrdiff_t>((w + column_block - 1) / column_block); ++block) {
+        if (df_cancelled(control)) continue;
+        TRACE_BEGIN(chunk, "block");
+        std::size_t x0 = static_cast<std::size_t>(block) * column_block;
+        std::size_t cols = w - x0 < column_block ? w - x0 : column_block;
+        // distance to the last true and false pixel seen by the scan, per column of the block
+        scan_type d_true[column_block];
+        scan_type d_false[column_block];
+
+        // downward scan leaves the distance to the nearest site above
+        for (std::size_t c = 0; c < cols; ++c) d_true[c] = d_false[c] = policy::scan_infinity();
+        for (std::size_t y = 0; y < h; ++y) {
+            const bool* mask_row = mask + y * w + x0;
+            Storage* out = pair_out + 2 * (y * w + x0);
+            for (std::size_t c = 0; c < cols; ++c) {
+                bool site = mask_row[c];
+                d_true[c] = site ? scan_type(0) : policy::scan_next(d_true[c]);
+                d_false[c] = site ? policy::scan_next(d_false[c]) : scan_type(0);
+                out[2 * c] = policy::store_distance(d_true[c]);
+                out[2 * c + 1] = policy::store_distance(d_false[c]);
+            }
+        }
+
+        // upward scan takes the nearer of both sides and squares it
+        for (std::size_t c = 0; c < cols; ++c) d_true[c] = d_false[c] = policy::scan_infinity();
+        for (std::size_t y = h; y-- > 0;) {
+            const bool* mask_row = mask + y * w + x0;
+            Storage* out = pair_out + 2 * (y * w + x0);
+            for (std::size_t c = 0; c < cols; ++c) {
+                bool site = mask_row[c];
+                d_true[c] = site ? scan_type(0) : policy::scan_next(d_true[c]);
+                d_false[c] = site ? policy::scan_next(d_false[c]) : scan_type(0);
+                scan_type above_true = policy::load_distance(out[2 * c]);
+                scan_type above_false = policy::load_distance(out[2 * c + 1]);
+                out[2 * c] = policy::store_squared(d_true[c] < above_true ? d_true[c] : above_true);
+                out[2 * c + 1] = policy::store_squared(d_false[c] < above_false ? d_false[c] : above_false);
+            }
+        }
+        df_progress(control, 2 * cols * h);
+        TRACE_END_INDEX(chunk, block);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+// Second pass of the streaming order over rows [y0,y1) of interleaved pairs, each field written into its own band
+template <typename Storage, typename Index, typename Metric, typename Epilogue>
+bool rows_dual(const Storage* __restrict img_pair, std::size_t w, std::size_t y0, std::size_t y1,
+               float* __restrict img_a_out, float* __restrict img_b_out, df_control* control) {
+    TRACE_BEGIN(region, "dist_transform_rows_dual");
+#pragma omp parallel
+    {
+        std::ptrdiff_t y;
+        envelope_buffers<Index> buffers(w, true);
+
+#pragma omp for schedule(static)
+        for (y = static_cast<std::ptrdiff_t>(y0); y < static_cast<std::ptrdiff_t>(y1); ++y) {
+            if (df_cancelled(control)) continue;
+            TRACE_BEGIN(row, "row");
+            const Storage* pair_slice = img_pair + 2 * (static_cast<std::size_t>(y) * w);
+            for (std::size_t x = 0; x < w; ++x) {
+                buffers.row_a[x] = storage<Storage>::load(pair_slice[2 * x]);
+                buffers.row_b[x] = storage<Storage>::load(pair_slice[2 * x + 1]);
+            }
+            // a "transpose" one row wide writes the row in place
+            std::size_t out_offset = (static_cast<std::size_t>(y) - y0) * w;
+            transform_1d<Index, Metric, Epilogue>(buffers.row_a, static_cast<Index>(w), 0, 1, buffers.v, buffers.h,
+                                                  buffers.z, img_a_out + out_offset);
+            transform_1d<Index, Metric, Epilogue>(buffers.row_b, static_cast<Index>(w), 0, 1, buffers.v, buffers.h,
+                                                  buffers.z, img_b_out + out_offset);
+            df_progress(control, 2 * w);
+            TRACE_END_INDEX(row, y);
+        }
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
+
+// Manhattan and chebyshev distances separate exactly into the distance g along rows and a pass along columns over g,
+// neither of which needs parabolas: both passes run in place on the field, without transposing. Distances are small
+// integers, exact in float. The column passes are policies of separable_2d, each running over blocks of columns so that
+// every step along a column covers a contiguous run of a row.
+
+// first pass, distances along one row in place, row must be binary (0 or INFINITY)
+inline void row_distances(float* __restrict row, std::size_t w) {
+    float d = std::numeric_limits<float>::infinity();
+    for (std::size_t x = 0; x < w; ++x) {
+        d = row[x] == 0.f ? 0.f : d + 1.f;
+        row[x] = d;
+    }
+    // the forward distance is 0 exactly at sites
+    d = std::numeric_limits<float>::infinity();
+    for (std::size_t x = w; x-- > 0;) {
+        d = row[x] == 0.f ? 0.f : d + 1.f;
+        row[x] = d < row[x] ? d : row[x];
+    }
+}
+
+// g(r) + |y - r| minimized over r by a downward and an upward scan
+struct manhattan {
+    static bool columns(float* img, std::size_t w, std::size_t h, df_control* control) {
+        TRACE_BEGIN(region, "dist_transform_manhattan_columns");
+        std::ptrdiff_t block;
+#pragma omp parallel for schedule(static)
+        for (block = 0; block < static_cast<std::ptrdiff_t>((w + column_block - 1) / column_block); ++block) {
+            if (df_cancelled(control)) continue;
+            TRACE_BEGIN(chunk, "block");
+            std::size_t x0 = static_cast<std::size_t>(block) * column_block;
+            std::size_t cols = w - x0 < column_block ? w - x0 : column_block;
+            for (std::size_t y = 1; y < h; ++y) {
+                float* __restrict row = img + y * w + x0;
+                const float* __restrict above = row - w;
+                for (std::size_t c = 0; c < cols; ++c) row[c] = above[c] + 1.f < row[c] ? above[c] + 1.f : row[c];
+            }
+            for (std::size_t y = h; y-- > 1;) {
+                float* __restrict row = img + (y - 1) * w + x0;
+                const float* __restrict below = row + w;
+                for (std::size_t c = 0; c < cols; ++c) row[c] = below[c] + 1.f < row[c] ? below[c] + 1.f : row[c];
+            }
+            df_progress(control, cols * h);
+            TRACE_END_INDEX(chunk, block);
+        }
+        TRACE_END(region);
+        return !df_cancelled(control);
+    }
+};
+
+// columns of one block of chebyshev's column pass, each keeps a stack of up to h segments
+constexpr std::size_t envelope_block = 64;
+
+// max(g(r), |y - r|) minimized over r by the lower envelope of these cones along each column, in integers
+// Reference: A General Algorithm for Computing Distance Transforms in Linear Time (A. Meijster, J. Roerdink,
+// W. Hesselink)
+struct chebyshev {
+    // the part of the envelope from row start on is the cone of site, whose g is height
+    struct segment {
+        std::uint32_t site;
+        std::uint32_t start;
+        std::uint32_t height;
+    };
+
+    static std::int64_t distance(std::int64_t y, std::int64_t r, std::int64_t g_r) {
+        std::int64_t displacement = y > r ? y - r : r - y;
+        return displacement > g_r ? displacement : g_r;
+    }
+    // last row where the cone of r is not above the cone of u, for r < u
+    static std::int64_t separator(std::int64_t r, std::int64_t u, std::int64_t g_r, std::int64_t g_u) {
+        std::int64_t middle = (r + u) / 2;
+        if (g_r <= g_u) return r + g_u > middle ? r + g_u : middle;
+        return u - g_r < middle ? u - g_r : middle;
+    }
+
+    static bool columns(float* img, std::size_t w, std::size_t h, df_control* control) {
+        TRACE_BEGIN(region, "dist_transform_chebyshev_columns");
+        // stands for no site, no distance within the image reaches it
+        auto infinity = static_cast<std::int64_t>(w + h);
+#pragma omp parallel
+        {
+            std::ptrdiff_t block;
+            // stack of the envelope's segments of each column, which keep the g of their site as it is overwritten
+            // in place before the segment's last use
+            auto* stacks = static_cast<segment*>(std::malloc(sizeof(segment) * h * envelope_block));
+            // top of each column's stack
+            std::ptrdiff_t top[envelope_block];
+
+#pragma omp for schedule(static)
+            for (block = 0; block < static_cast<std::ptrdiff_t>((w + envelope_block - 1) / envelope_block); ++block) {
+                if (df_cancelled(control)) continue;
+                TRACE_BEGIN(chunk, "block");
+                std::size_t x0 = static_cast<std::size_t>(block) * envelope_block;
+                std::size_t cols = w - x0 < envelope_block ? w - x0 : envelope_block;
+
+                // downward, build the envelope
+                for (std::size_t y = 0; y < h; ++y) {
+                    const float* row = img + y * w + x0;
+                    for (std::size_t c = 0; c < cols; ++c) {
+                        segment* stack = stacks + c * h;
+                        std::int64_t g = std::isinf(row[c]) ? infinity : static_cast<std::int64_t>(row[c]);
+                        std::ptrdiff_t k = y == 0 ? -1 : top[c];
+                        // drop the segments whose cone is above y's at their start
+                        while (k >= 0 && distance(stack[k].start, stack[k].site, stack[k].height) >
+                                             distance(stack[k].start, static_cast<std::int64_t>(y), g)) {
+                            --k;
+                        }
+                        std::int64_t start = k >= 0 ? 1 + separator(stack[k].site, y, stack[k].height, g) : 0;
+                        if (start < static_cast<std::int64_t>(h)) {
+                            stack[++k] = {static_cast<std::uint32_t>(y), static_cast<std::uint32_t>(start),
+                                          static_cast<std::uint32_t>(g)};
+                        }
+                        top[c] = k;
+                    }
+                }
+
+                // upward, read the envelope off the segments
+                for (std::size_t y = h; y-- > 0;) {
+                    float* row = img + y * w + x0;
+                    for (std::size_t c = 0; c < cols; ++c) {
+                        const segment& nearest = stacks[c * h + static_cast<std::size_t>(top[c])];
+                        std::int64_t d = distance(static_cast<std::int64_t>(y), nearest.site, nearest.height);
+                        row[c] = d >= infinity ? std::numeric_limits<float>::infinity() : static_cast<float>(d);
+                        if (y == nearest.start) --top[c];
+                    }
+                }
+                df_progress(control, cols * h);
+                TRACE_END_INDEX(chunk, block);
+            }
+
+            std::free(stacks);
+        }
+        TRACE_END(region);
+        return !df_cancelled(control);
+    }
+};
+
+// Manhattan or chebyshev distance of a binary img (0 or INFINITY) in place
+template <typename Metric>
+bool separable_2d(float* img, std::size_t w, std::size_t h, df_control* control) {
+    TRACE_BEGIN(region, "dist_transform_row_distances");
+    std::ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < static_cast<std::ptrdiff_t>(h); ++y) {
+        if (df_cancelled(control)) continue;
+        row_distances(img + static_cast<std::size_t>(y) * w, w);
+        df_progress(control, w);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control) && Metric::columns(img, w, h, control);
+}
+
+// both fields of mask, inside_out gets the distance to the nearest true pixel, outside_out to the nearest false one
+template <typename Metric>
+bool separable_2d_dual(const bool* mask, float* inside_out, float* outside_out, std::size_t w, std::size_t h,
+                       df_control* control) {
+    TRACE_BEGIN(region, "dist_transform_row_distances_dual");
+    std::ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < static_cast<std::ptrdiff_t>(h); ++y) {
+        if (df_cancelled(control)) continue;
+        std::size_t offset = static_cast<std::size_t>(y) * w;
+        for (std::size_t x = 0; x < w; ++x) {
+            inside_out[offset + x] = mask[offset + x] ? 0.f : std::numeric_limits<float>::infinity();
+            outside_out[offset + x] = mask[offset + x] ? std::numeric_limits<float>::infinity() : 0.f;
+        }
+        row_distances(inside_out + offset, w);
+        row_distances(outside_out + offset, w);
+        df_progress(control, 2 * w);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control) && Metric::columns(inside_out, w, h, control) &&
+           Metric::columns(outside_out, w, h, control);
+}
+
+} // namespace df_core
+
+#endif
@@ -0,0 +1,126 @@
+#include "df.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+// Meijster/Roerdink/Hesselink linear time euclidean distance transform
+// Reference: A General Algorithm for Computing Distance Transforms in Linear Time (A. Meijster, J. Roerdink,
+// W. Hesselink)
+
+// columns handled together by a thread in the first phase, keeps its row sweeps on contiguous memory
+#define COLUMN_BLOCK 256
+
+// Phase 1: distance to the nearest site within each column, computed in place with a downward and an upward sweep.
+// Both sweeps walk rows in order and touch a contiguous block of columns at a time.
+static void column_phase(float* img, size_t w, size_t h, struct df_control* control) {
+    TRACE_BEGIN(region, "meijster_column_phase");
+    ptrdiff_t block;
+    ptrdiff_t n_blocks = (ptrdiff_t)((w + COLUMN_BLOCK - 1) / COLUMN_BLOCK);
+#pragma omp parallel for schedule(static)
+    for (block = 0; block < n_blocks; ++block) {
+        if (df_cancelled(control)) continue;
+        TRACE_BEGIN(chunk, "block");
+        size_t x_begin = (size_t)block * COLUMN_BLOCK;
+        size_t x_end = x_begin + COLUMN_BLOCK < w ? x_begin + COLUMN_BLOCK : w;
+
+        // sites are already 0 and everything else INFINITY, which stays INFINITY until a site is passed
+        for (size_t y = 1; y < h; ++y) {
+            float* restrict row = img + y * w;
+            const float* restrict prev = img + (y - 1) * w;
+            for (size_t x = x_begin; x < x_end; ++x) {
+                float down = prev[x] + 1.f;
+                row[x] = row[x] < down ? row[x] : down;
+            }
+        }
+        for (size_t y = h - 1; y-- > 0;) {
+            float* restrict row = img + y * w;
+            const float* restrict next = img + (y + 1) * w;
+            for (size_t x = x_begin; x < x_end; ++x) {
+                float up = next[x] + 1.f;
+                row[x] = row[x] < up ? row[x] : up;
+            }
+        }
+        df_progress(control, (x_end - x_begin) * h);
+        TRACE_END_INDEX(chunk, block);
+    }
+    TRACE_END(region);
+}
+
+// Phase 2: combines column distances along one row with the lower envelope of integer parabolas
+// row -- column distances of the row on input, euclidean distances on output
+// w -- size of row
+// inf -- stand-in for columns without sites, larger than any distance within the image
+// g -- squared column distances buffer, sized w
+// s -- parabola vertex buffer, sized w
+// t -- parabola start buffer, sized w
+static void row_phase(float* restrict row, size_t w, int64_t inf, int64_t* restrict g, ptrdiff_t* restrict s,
+                      ptrdiff_t* restrict t) {
+    for (size_t x = 0; x < w; ++x) {
+        int64_t d = isinf(row[x]) ? inf : (int64_t)row[x];
+        g[x] = d * d;
+    }
+
+#define F(x, i) ((int64_t)((x) - (i)) * (int64_t)((x) - (i)) + g[i])
+#define SEP(i, u) (((int64_t)(u) * (u) - (int64_t)(i) * (i) + g[u] - g[i]) / (2 * (int64_t)((u) - (i))))
+
+    ptrdiff_t m = (ptrdiff_t)w;
+    ptrdiff_t q = 0;
+    s[0] = 0;
+    t[0] = 0;
+    for (ptrdiff_t u = 1; u < m; ++u) {
+        while (q >= 0 && F(t[q], s[q]) > F(t[q], u)) --q;
+        if (q < 0) {
+            q = 0;
+            s[0] = u;
+        } else {
+            ptrdiff_t start = 1 + (ptrdiff_t)SEP(s[q], u);
+            if (start < m) {
+                ++q;
+                s[q] = u;
+                t[q] = start;
+            }
+        }
+    }
+
+    for (ptrdiff_t u = m - 1; u >= 0; --u) {
+        int64_t d_2 = F(u, s[q]);
+        // only reachable through columns without sites, which means the image has none
+        row[u] = d_2 >= inf * inf ? INFINITY : sqrtf((float)d_2);
+        if (u == t[q]) --q;
+    }
+
+#undef SEP
+#undef F
+}
+
+bool dist_transform_2d_meijster(float* img, size_t w, size_t h, struct df_control* control) {
+    column_phase(img, w, h, control);
+    if (df_cancelled(control)) return false;
+
+    int64_t inf = (int64_t)(w + h);
+    TRACE_BEGIN(region, "meijster_row_phase");
+#pragma omp parallel
+    {
+        ptrdiff_t y;
+        int64_t* g = malloc(sizeof(int64_t) * w);
+        ptrdiff_t* s = malloc(sizeof(ptrdiff_t) * w);
+        ptrdiff_t* t = malloc(sizeof(ptrdiff_t) * w);
+
+#pragma omp for schedule(static)
+        for (y = 0; y < (ptrdiff_t)(h); ++y) {
+            if (df_cancelled(control)) continue;
+            TRACE_BEGIN(row, "row");
+            row_phase(img + (size_t)y * w, w, inf, g, s, t);
+            df_progress(control, w);
+            TRACE_END_INDEX(row, y);
+        }
+
+        free(t);
+        free(s);
+        free(g);
+    }
+    TRACE_END(region);
+    return !df_cancelled(control);
+}
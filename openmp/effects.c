@@ -0,0 +1,152 @@
+#include "effects.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// parses RRGGBB or RRGGBBAA
+static bool parse_color(const char* str, unsigned char color_out[4]) {
+    size_t len = strlen(str);
+    if (len != 6 && len != 8) return false;
+    if (strspn(str, "0123456789abcdefABCDEF") != len) return false;
+
+    color_out[3] = 255;
+    for (size_t c = 0; c < len / 2; ++c) {
+        char byte[3] = {str[c * 2], str[c * 2 + 1], '\0'};
+        color_out[c] = (unsigned char)strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+// splits spec on ':' into at most max_fields fields held in buffer, returns the number of fields
+static size_t split_fields(const char* spec, char* buffer, size_t buffer_size, char** fields, size_t max_fields) {
+    snprintf(buffer, buffer_size, "%s", spec);
+    size_t n = 0;
+    char* field = buffer;
+    while (n < max_fields) {
+        fields[n++] = field;
+        char* colon = strchr(field, ':');
+        if (colon == NULL) break;
+        *colon = '\0';
+        field = colon + 1;
+    }
+    return n;
+}
+
+static bool parse_number(const char* str, float* value_out) {
+    char* end;
+    *value_out = strtof(str, &end);
+    return end != str && *end == '\0' && isfinite(*value_out);
+}
+
+// ramp from transparent color at d0 to color at d1
+static void fade_in(struct effect* e, float d0, float d1, const unsigned char color[4]) {
+    e->d0 = d0;
+    e->d1 = d1;
+    memcpy(e->c0, color, 3);
+    e->c0[3] = 0;
+    memcpy(e->c1, color, 4);
+}
+
+bool effect_parse(const char* spec, struct effect* effect_out) {
+    char buffer[256];
+    char* f[6];
+    size_t n = split_fields(spec, buffer, sizeof(buffer), f, 6);
+
+    struct effect e;
+    memset(&e, 0, sizeof(e));
+    unsigned char color[4];
+    float a, b, r;
+
+    if (strcmp(f[0], "fill") == 0 && n == 2 && parse_color(f[1], color)) {
+        fade_in(&e, -0.5f, 0.5f, color);
+    } else if (strcmp(f[0], "outline") == 0 && n == 3 && parse_number(f[1], &a) && a > 0 && parse_color(f[2], color)) {
+        // opaque up to half the width from the edge, fading out over the next pixel
+        e.absolute = true;
+        e.d0 = a * 0.5f - 0.5f;
+        e.d1 = a * 0.5f + 0.5f;
+        memcpy(e.c0, color, 4);
+        memcpy(e.c1, color, 3);
+        e.c1[3] = 0;
+    } else if (strcmp(f[0], "glow") == 0 && n == 3 && parse_number(f[1], &r) && r > 0 && parse_color(f[2], color)) {
+        fade_in(&e, -r, 0.f, color);
+    } else if (strcmp(f[0], "shadow") == 0 && n == 5 && parse_number(f[1], &a) && parse_number(f[2], &b) &&
+               parse_number(f[3], &r) && r > 0 && parse_color(f[4], color)) {
+        fade_in(&e, -r, 0.f, color);
+        e.dx = (int)lroundf(a);
+        e.dy = (int)lroundf(b);
+    } else if (strcmp(f[0], "ramp") == 0 && n == 5 && parse_number(f[1], &a) && parse_number(f[2], &b) && a < b &&
+               parse_color(f[3], e.c0) && parse_color(f[4], e.c1)) {
+        e.d0 = a;
+        e.d1 = b;
+    } else {
+        return false;
+    }
+
+    *effect_out = e;
+    return true;
+}
+
+size_t effect_reach(const struct effect* effects, size_t n_effects) {
+    size_t reach = 0;
+    for (size_t i = 0; i < n_effects; ++i) {
+        const struct effect* e = &effects[i];
+        float d = fmaxf(fabsf(e->d0), fabsf(e->d1));
+        size_t r = (size_t)ceilf(d) + (size_t)abs(e->dx) + (size_t)abs(e->dy);
+        reach = r > reach ? r : reach;
+    }
+    return reach;
+}
+
+size_t effect_row_halo(const struct effect* effects, size_t n_effects) {
+    size_t halo = 0;
+    for (size_t i = 0; i < n_effects; ++i) {
+        size_t dy = (size_t)(effects[i].dy < 0 ? -effects[i].dy : effects[i].dy);
+        halo = dy > halo ? dy : halo;
+    }
+    return halo;
+}
+
+void effects_render(const float* field, size_t w, size_t h, size_t y0, size_t y1, const struct effect* effects,
+                    size_t n_effects, unsigned char* rgba_out) {
+    ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = (ptrdiff_t)(y0); y < (ptrdiff_t)(y1); ++y) {
+        for (size_t x = 0; x < w; ++x) {
+            float out[4] = {0.f, 0.f, 0.f, 0.f};
+
+            for (size_t i = 0; i < n_effects; ++i) {
+                const struct effect* e = &effects[i];
+
+                // sample the field at the offset position, clamped to the image
+                ptrdiff_t sx = (ptrdiff_t)x - e->dx;
+                ptrdiff_t sy = y - e->dy;
+                sx = sx < 0 ? 0 : (sx >= (ptrdiff_t)w ? (ptrdiff_t)w - 1 : sx);
+                sy = sy < 0 ? 0 : (sy >= (ptrdiff_t)h ? (ptrdiff_t)h - 1 : sy);
+                float d = field[(size_t)sy * w + (size_t)sx];
+                if (e->absolute) d = fabsf(d);
+
+                float t = (d - e->d0) / (e->d1 - e->d0);
+                t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+
+                float src[4];
+                for (size_t c = 0; c < 4; ++c) src[c] = ((float)e->c0[c] + ((float)e->c1[c] - (float)e->c0[c]) * t);
+                float src_a = src[3] / 255.f;
+
+                // straight alpha "over"
+                float out_a = src_a + out[3] * (1.f - src_a);
+                if (out_a > 0.f) {
+                    for (size_t c = 0; c < 3; ++c) {
+                        out[c] = (src[c] * src_a + out[c] * out[3] * (1.f - src_a)) / out_a;
+                    }
+                }
+                out[3] = out_a;
+            }
+
+            unsigned char* px = rgba_out + (((size_t)y - y0) * w + x) * 4;
+            for (size_t c = 0; c < 3; ++c) px[c] = (unsigned char)(out[c] + 0.5f);
+            px[3] = (unsigned char)(out[3] * 255.f + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A distance-to-colour ramp. Distances are signed in pixels, positive inside the shape and 0 on its edge.
+// Pixels at distance d0 or less get c0, at d1 or more get c1, and in between a linear blend.
+struct effect {
+    float d0;
+    float d1;
+    // straight (non-premultiplied) RGBA
+    unsigned char c0[4];
+    unsigned char c1[4];
+    // ramp over the absolute distance, giving a band centred on the edge
+    bool absolute;
+    // the field is sampled this many pixels up-left of each output pixel, so the ramp appears shifted by it
+    int dx;
+    int dy;
+};
+
+// Parses one effect, returns false if spec is malformed. Specs are
+//   fill:RRGGBB[AA]                      the shape itself, antialiased over a pixel
+//   outline:W:RRGGBB[AA]                 band of width W centred on the edge
+//   glow:R:RRGGBB[AA]                    fades out over R pixels outside the edge
+//   shadow:DX:DY:R:RRGGBB[AA]            glow of the shape moved by (DX, DY)
+//   ramp:D0:D1:RRGGBB[AA]:RRGGBB[AA]     raw ramp
+bool effect_parse(const char* spec, struct effect* effect_out);
+
+// furthest distance from the edge, plus offset, that an effect reads, in pixels
+size_t effect_reach(const struct effect* effects, size_t n_effects);
+
+// rows of the field beyond those rendered that an effect reads
+size_t effect_row_halo(const struct effect* effects, size_t n_effects);
+
+// Composites effects over a transparent background in list order (the first is the bottom layer), for rows [y0,y1).
+// field -- w*h signed distances
+// rgba_out -- (y1-y0)*w*4 bytes
+void effects_render(const float* field, size_t w, size_t h, size_t y0, size_t y1, const struct effect* effects,
+                    size_t n_effects, unsigned char* rgba_out);
+
+#endif
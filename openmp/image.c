@@ -0,0 +1,339 @@
+#include "image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// largest stored deflate block
+#define DEFLATE_STORED_MAX 65535
+
+enum FILETYPE read_filetype(const char* string) {
+    const char* type_table[] = {"png", "bmp", "jpg", "tga"};
+    size_t n_types = sizeof(type_table) / sizeof(const char*);
+    for (size_t filetype = 0; filetype < n_types; ++filetype) {
+        if (strncmp(string, type_table[filetype], 3) == 0) return (enum FILETYPE)filetype;
+    }
+    return FT_NONE;
+}
+
+enum FILETYPE deduce_filetype(const char* filename, enum FILETYPE specified) {
+    if (specified != FT_NONE) return specified;
+
+    const char* dot = strrchr(filename, '.');
+    enum FILETYPE deduced = dot != NULL ? read_filetype(dot + 1) : FT_NONE;
+    return deduced != FT_NONE ? deduced : FT_PNG;
+}
+
+int filename_pattern_numbers(const char* pattern) {
+    int n_numbers = 0;
+    for (const char* p = pattern; *p; ++p) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+        if (*p == '0') ++p;
+        // widths beyond two digits would only overflow the paths built from the pattern
+        for (size_t digits = 0; *p >= '0' && *p <= '9'; ++p) {
+            if (++digits > 2) return -1;
+        }
+        if (*p != 'd' && *p != 'i') return -1;
+        ++n_numbers;
+    }
+    return n_numbers;
+}
+
+static void write_to_file(void* context, void* data, int size) { fwrite(data, (size_t)size, 1, (FILE*)context); }
+
+void byte_buffer_write(void* context, void* data, int size) {
+    struct byte_buffer* buffer = context;
+    if (buffer->failed) return;
+    if (buffer->size + (size_t)size > buffer->capacity) {
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity : 1 << 16;
+        while (buffer->size + (size_t)size > capacity) capacity *= 2;
+        unsigned char* grown = realloc(buffer->data, capacity);
+        if (grown == NULL) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, (size_t)size);
+    buffer->size += (size_t)size;
+}
+
+bool encode_image(stbi_write_func* func, void* context, enum FILETYPE filetype, int w, int h, int comp,
+                  const unsigned char* data, int quality) {
+    switch (filetype) {
+    case FT_BMP: return stbi_write_bmp_to_func(func, context, w, h, comp, data) != 0;
+    case FT_JPG: return stbi_write_jpg_to_func(func, context, w, h, comp, data, quality) != 0;
+    case FT_TGA: return stbi_write_tga_to_func(func, context, w, h, comp, data) != 0;
+    case FT_PNG:
+    case FT_NONE:
+    default: return stbi_write_png_to_func(func, context, w, h, comp, data, w * comp) != 0;
+    }
+}
+
+bool write_image(const char* filename, enum FILETYPE filetype, int w, int h, int comp, const unsigned char* data,
+                 int quality) {
+    bool to_stdout = strcmp(filename, "-") == 0;
+    FILE* file = to_stdout ? stdout : fopen(filename, "wb");
+    if (file == NULL) return false;
+
+    bool status = encode_image(write_to_file, file, filetype, w, h, comp, data, quality);
+
+    if (to_stdout) {
+        status = fflush(stdout) == 0 && status;
+    } else {
+        status = fclose(file) == 0 && status;
+    }
+    return status;
+}
+
+bool image_stream_supported(enum FILETYPE filetype) { return filetype != FT_JPG; }
+
+static void put_le16(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static void put_le32(unsigned char* p, uint32_t v) {
+    put_le16(p, v & 0xffff);
+    put_le16(p + 2, v >> 16);
+}
+
+static void put_be32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)((v >> 16) & 0xff);
+    p[2] = (unsigned char)((v >> 8) & 0xff);
+    p[3] = (unsigned char)(v & 0xff);
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char* data, size_t size) {
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32_update(uint32_t adler, const unsigned char* data, size_t size) {
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    for (size_t i = 0; i < size; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void stream_write(struct image_stream* stream, const void* data, size_t size) {
+    stream->ok = stream->ok && fwrite(data, 1, size, stream->file) == size;
+}
+
+static void png_chunk(struct image_stream* stream, const char* type, const unsigned char* data, size_t size) {
+    unsigned char length[4];
+    unsigned char crc[4];
+    put_be32(length, (uint32_t)size);
+    put_be32(crc, crc32_update(crc32_update(0, (const unsigned char*)type, 4), data, size));
+    stream_write(stream, length, 4);
+    stream_write(stream, type, 4);
+    stream_write(stream, data, size);
+    stream_write(stream, crc, 4);
+}
+
+static void write_header(struct image_stream* stream) {
+    int w = stream->w;
+    int h = stream->h;
+    int comp = stream->comp;
+    switch (stream->filetype) {
+    case FT_TGA: {
+        // grayscale or truecolor, uncompressed, origin at the top left
+        unsigned char header[18] = {0};
+        header[2] = comp < 3 ? 3 : 2;
+        put_le16(header + 12, (uint32_t)w);
+        put_le16(header + 14, (uint32_t)h);
+        header[16] = (unsigned char)(comp * 8);
+        header[17] = (unsigned char)((comp == 2 || comp == 4 ? 8 : 0) | 0x20);
+        stream_write(stream, header, sizeof(header));
+    } break;
+    case FT_BMP: {
+        // 24 bits per pixel, or 32 with alpha through a v4 header, negative height for top-down rows
+        bool alpha = comp == 4;
+        uint32_t info_size = alpha ? 108 : 40;
+        uint32_t row_size = alpha ? (uint32_t)w * 4 : ((uint32_t)w * 3 + 3) & ~3u;
+        unsigned char header[14 + 108] = {0};
+        header[0] = 'B';
+        header[1] = 'M';
+        put_le32(header + 2, 14 + info_size + row_size * (uint32_t)h);
+        put_le32(header + 10, 14 + info_size);
+        put_le32(header + 14, info_size);
+        put_le32(header + 18, (uint32_t)w);
+        put_le32(header + 22, (uint32_t)-h);
+        put_le16(header + 26, 1);
+        put_le16(header + 28, alpha ? 32 : 24);
+        if (alpha) {
+            // bitfields with channel masks, windows colour space
+            put_le32(header + 30, 3);
+            put_le32(header + 54, 0x00ff0000u);
+            put_le32(header + 58, 0x0000ff00u);
+            put_le32(header + 62, 0x000000ffu);
+            put_le32(header + 66, 0xff000000u);
+            put_le32(header + 70, 0x57696e20u);
+        }
+        stream_write(stream, header, 14 + info_size);
+    } break;
+    case FT_PNG:
+    case FT_NONE:
+    default: {
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        static const unsigned char color_types[5] = {0, 0, 4, 2, 6};
+        unsigned char ihdr[13] = {0};
+        put_be32(ihdr, (uint32_t)w);
+        put_be32(ihdr + 4, (uint32_t)h);
+        ihdr[8] = 8;
+        ihdr[9] = color_types[comp];
+        stream_write(stream, signature, sizeof(signature));
+        png_chunk(stream, "IHDR", ihdr, sizeof(ihdr));
+    } break;
+    }
+}
+
+bool image_stream_open(struct image_stream* stream, const char* filename, enum FILETYPE filetype, int w, int h,
+                       int comp) {
+    memset(stream, 0, sizeof(*stream));
+    if (!image_stream_supported(filetype) || w <= 0 || h <= 0 || comp < 1 || comp > 4) return false;
+    if (filetype == FT_TGA && (w > 0xffff || h > 0xffff)) return false;
+
+    stream->to_stdout = strcmp(filename, "-") == 0;
+    stream->file = stream->to_stdout ? stdout : fopen(filename, "wb");
+    if (stream->file == NULL) return false;
+
+    stream->filetype = filetype;
+    stream->w = w;
+    stream->h = h;
+    stream->comp = comp;
+    stream->adler = 1;
+    stream->ok = true;
+    write_header(stream);
+    return stream->ok;
+}
+
+// one band of png image data as an IDAT chunk, the zlib stream spans all of them
+static bool write_png_rows(struct image_stream* stream, const unsigned char* rows, int n_rows) {
+    size_t row_size = (size_t)stream->w * (size_t)stream->comp;
+    size_t raw_size = (size_t)n_rows * (1 + row_size);
+    size_t n_blocks = (raw_size + DEFLATE_STORED_MAX - 1) / DEFLATE_STORED_MAX;
+    bool first = stream->rows_written == 0;
+    bool last = stream->rows_written + n_rows == stream->h;
+
+    unsigned char* raw = malloc(raw_size);
+    unsigned char* chunk = malloc(2 + raw_size + 5 * n_blocks + 4);
+    if (raw == NULL || chunk == NULL) {
+        free(chunk);
+        free(raw);
+        return false;
+    }
+
+    // every row gets filter type none
+    for (int y = 0; y < n_rows; ++y) {
+        raw[(size_t)y * (1 + row_size)] = 0;
+        memcpy(raw + (size_t)y * (1 + row_size) + 1, rows + (size_t)y * row_size, row_size);
+    }
+    stream->adler = adler32_update(stream->adler, raw, raw_size);
+
+    size_t size = 0;
+    if (first) {
+        // deflate, 32k window, no preset dictionary, fastest level
+        chunk[size++] = 0x78;
+        chunk[size++] = 0x01;
+    }
+    for (size_t offset = 0; offset < raw_size; offset += DEFLATE_STORED_MAX) {
+        size_t block = raw_size - offset < DEFLATE_STORED_MAX ? raw_size - offset : DEFLATE_STORED_MAX;
+        chunk[size++] = last && offset + block == raw_size ? 1 : 0;
+        put_le16(chunk + size, (uint32_t)block);
+        put_le16(chunk + size + 2, (uint32_t)~block & 0xffff);
+        memcpy(chunk + size + 4, raw + offset, block);
+        size += 4 + block;
+    }
+    if (last) {
+        put_be32(chunk + size, stream->adler);
+        size += 4;
+    }
+    png_chunk(stream, "IDAT", chunk, size);
+
+    free(chunk);
+    free(raw);
+    return stream->ok;
+}
+
+// rows converted to the channel order and padding of tga or bmp
+static bool write_swizzled_rows(struct image_stream* stream, const unsigned char* rows, int n_rows) {
+    int comp = stream->comp;
+    bool bmp = stream->filetype == FT_BMP;
+    // bmp has no grayscale, gray is expanded and a lone gray alpha dropped
+    size_t out_comp = bmp ? (comp == 4 ? 4 : 3) : (size_t)comp;
+    size_t out_row_size = (size_t)stream->w * out_comp;
+    if (bmp) out_row_size = (out_row_size + 3) & ~(size_t)3;
+
+    unsigned char* out = calloc(out_row_size, 1);
+    if (out == NULL) return false;
+
+    for (int y = 0; y < n_rows && stream->ok; ++y) {
+        const unsigned char* row = rows + (size_t)y * (size_t)stream->w * (size_t)comp;
+        for (int x = 0; x < stream->w; ++x) {
+            const unsigned char* px = row + (size_t)x * (size_t)comp;
+            unsigned char* dst = out + (size_t)x * out_comp;
+            if (comp >= 3) {
+                // both store blue first
+                dst[0] = px[2];
+                dst[1] = px[1];
+                dst[2] = px[0];
+                if (comp == 4) dst[3] = px[3];
+            } else if (bmp) {
+                dst[0] = dst[1] = dst[2] = px[0];
+            } else {
+                memcpy(dst, px, (size_t)comp);
+            }
+        }
+        stream_write(stream, out, out_row_size);
+    }
+
+    free(out);
+    return stream->ok;
+}
+
+bool image_stream_write_rows(struct image_stream* stream, const unsigned char* rows, int n_rows) {
+    if (!stream->ok || n_rows > stream->h - stream->rows_written) return stream->ok = false;
+
+    if (stream->filetype == FT_TGA || stream->filetype == FT_BMP) {
+        write_swizzled_rows(stream, rows, n_rows);
+    } else {
+        stream->ok = write_png_rows(stream, rows, n_rows);
+    }
+    stream->rows_written += n_rows;
+    stream->ok = stream->ok && fflush(stream->file) == 0;
+    return stream->ok;
+}
+
+bool image_stream_close(struct image_stream* stream) {
+    if (stream->file == NULL) return false;
+
+    bool status = stream->ok && stream->rows_written == stream->h;
+    if (status && stream->filetype != FT_TGA && stream->filetype != FT_BMP) {
+        png_chunk(stream, "IEND", (const unsigned char*)"", 0);
+        status = stream->ok;
+    }
+
+    if (stream->to_stdout) {
+        status = fflush(stdout) == 0 && status;
+    } else {
+        status = fclose(stream->file) == 0 && status;
+    }
+    stream->file = NULL;
+    return status;
+}
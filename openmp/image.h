@@ -0,0 +1,69 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stb/stb_image_write.h"
+
+enum FILETYPE { FT_NONE = -1, FT_PNG, FT_BMP, FT_JPG, FT_TGA };
+
+enum FILETYPE read_filetype(const char* string);
+
+// filetype of filename by its extension unless one was specified, png if neither gives one
+enum FILETYPE deduce_filetype(const char* filename, enum FILETYPE specified);
+
+// number of %d or %i conversions, optionally with a zero flag and a width (such as %04d), in a pattern naming numbered
+// files through printf, or -1 if it has any other conversion than %%
+int filename_pattern_numbers(const char* pattern);
+
+// encodes an image through func, comp channels of 8 bits each
+bool encode_image(stbi_write_func* func, void* context, enum FILETYPE filetype, int w, int h, int comp,
+                  const unsigned char* data, int quality);
+
+// growable buffer encoders write into, failed is set if it could not grow
+struct byte_buffer {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+};
+
+// stbi_write_func appending to the byte_buffer given as context
+void byte_buffer_write(void* context, void* data, int size);
+
+// encodes an image into filename, "-" writes to stdout
+bool write_image(const char* filename, enum FILETYPE filetype, int w, int h, int comp, const unsigned char* data,
+                 int quality);
+
+// Incremental encoder taking rows top to bottom as they become available, for png (stored, uncompressed deflate
+// blocks), tga (uncompressed, top-left origin) and bmp (top-down). Each write is flushed so readers on a pipe see it
+// right away.
+struct image_stream {
+    FILE* file;
+    bool to_stdout;
+    enum FILETYPE filetype;
+    int w;
+    int h;
+    int comp;
+    int rows_written;
+    // running adler-32 of the png image data
+    uint32_t adler;
+    bool ok;
+};
+
+// whether filetype can be written through an image_stream
+bool image_stream_supported(enum FILETYPE filetype);
+
+// opens filename ("-" for stdout) and writes the header, returns false on failure
+bool image_stream_open(struct image_stream* stream, const char* filename, enum FILETYPE filetype, int w, int h,
+                       int comp);
+
+// appends n_rows rows of w*comp bytes each
+bool image_stream_write_rows(struct image_stream* stream, const unsigned char* rows, int n_rows);
+
+// writes the trailer once all rows were written and closes the file, returns false if any step failed
+bool image_stream_close(struct image_stream* stream);
+
+#endif
@@ -0,0 +1,174 @@
+#include "metrics.h"
+
+#include <math.h>
+
+#include <omp.h>
+
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BITS)
+
+static const char* stage_names[] = {"queue", "decode", "compute", "encode", "total"};
+
+static size_t bucket_of(uint64_t us) {
+    if (us < 2 * HISTOGRAM_SUB_BUCKETS) return (size_t)us;
+    if (us > UINT32_MAX) us = UINT32_MAX;
+    size_t msb = 0;
+    while ((us >> msb) > 1) ++msb;
+    // shifted into [HISTOGRAM_SUB_BUCKETS, 2 * HISTOGRAM_SUB_BUCKETS)
+    size_t shift = msb - HISTOGRAM_SUB_BITS;
+    return shift * HISTOGRAM_SUB_BUCKETS + (size_t)(us >> shift);
+}
+
+// largest value counted in bucket
+static uint64_t bucket_high(size_t bucket) {
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) return bucket;
+    size_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    return ((uint64_t)(bucket - shift * HISTOGRAM_SUB_BUCKETS) << shift) + ((uint64_t)1 << shift) - 1;
+}
+
+static void histogram_init(struct histogram* histogram) {
+    for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) atomic_init(&histogram->counts[b], 0);
+    atomic_init(&histogram->count, 0);
+    atomic_init(&histogram->sum_us, 0);
+    atomic_init(&histogram->max_us, 0);
+}
+
+void metrics_init(struct metrics* metrics, const char* path, double interval) {
+    for (size_t s = 0; s < METRICS_STAGES; ++s) histogram_init(&metrics->stages[s]);
+    atomic_init(&metrics->completed, 0);
+    atomic_init(&metrics->failed, 0);
+    metrics->start = omp_get_wtime();
+    metrics->path = path;
+    metrics->interval = interval;
+    metrics->last_write = metrics->start;
+}
+
+void metrics_record(struct metrics* metrics, enum STAGE stage, double seconds) {
+    struct histogram* histogram = &metrics->stages[stage];
+    uint64_t us = seconds > 0.0 ? (uint64_t)llround(seconds * 1e6) : 0;
+    atomic_fetch_add_explicit(&histogram->counts[bucket_of(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum_us, us, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&histogram->max_us, &max, us, memory_order_relaxed,
+                                                              memory_order_relaxed)) {
+    }
+}
+
+void metrics_lap(struct metrics* metrics, enum STAGE stage, double* t) {
+    double now = omp_get_wtime();
+    if (metrics != NULL) metrics_record(metrics, stage, now - *t);
+    *t = now;
+}
+
+void metrics_job_done(struct metrics* metrics, bool ok) {
+    atomic_fetch_add_explicit(ok ? &metrics->completed : &metrics->failed, 1, memory_order_relaxed);
+}
+
+double histogram_quantile(const struct histogram* histogram, double q) {
+    uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    if (count == 0) return 0.0;
+    uint64_t max = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+
+    // rank of the value, at least the first
+    uint64_t rank = (uint64_t)ceil(q * (double)count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+        seen += atomic_load_explicit(&histogram->counts[b], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t high = bucket_high(b);
+            return (double)(high < max ? high : max) * 1e-6;
+        }
+    }
+    return (double)max * 1e-6;
+}
+
+static double histogram_max(const struct histogram* histogram) {
+    return (double)atomic_load_explicit(&histogram->max_us, memory_order_relaxed) * 1e-6;
+}
+
+void metrics_print(const struct metrics* metrics, FILE* stream) {
+    fprintf(stream, "%-8s %10s %12s %12s %12s %12s\n", "stage", "count", "p50 (ms)", "p90 (ms)", "p99 (ms)",
+            "max (ms)");
+    for (size_t s = 0; s < METRICS_STAGES; ++s) {
+        const struct histogram* histogram = &metrics->stages[s];
+        uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        if (count == 0) continue;
+        fprintf(stream, "%-8s %10llu %12.3f %12.3f %12.3f %12.3f\n", stage_names[s], (unsigned long long)count,
+                histogram_quantile(histogram, 0.5) * 1000.0, histogram_quantile(histogram, 0.9) * 1000.0,
+                histogram_quantile(histogram, 0.99) * 1000.0, histogram_max(histogram) * 1000.0);
+    }
+
+    uint64_t completed = atomic_load_explicit(&metrics->completed, memory_order_relaxed);
+    uint64_t failed = atomic_load_explicit(&metrics->failed, memory_order_relaxed);
+    double elapsed = omp_get_wtime() - metrics->start;
+    fprintf(stream, "%llu images in %.3f s, %.2f images/s, %llu failed\n", (unsigned long long)completed, elapsed,
+            elapsed > 0.0 ? (double)completed / elapsed : 0.0, (unsigned long long)failed);
+}
+
+bool metrics_write(const struct metrics* metrics, const char* path, const struct metrics_counter* extra,
+                   size_t n_extra) {
+    char temp_path[4096];
+    if ((size_t)snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= sizeof(temp_path)) return false;
+    FILE* file = fopen(temp_path, "w");
+    if (file == NULL) return false;
+
+    fputs("# HELP chaq_sdfgen_stage_seconds Latency of each stage of a job.\n"
+          "# TYPE chaq_sdfgen_stage_seconds summary\n",
+          file);
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    for (size_t s = 0; s < METRICS_STAGES; ++s) {
+        const struct histogram* histogram = &metrics->stages[s];
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(double); ++q) {
+            fprintf(file, "chaq_sdfgen_stage_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n", stage_names[s],
+                    quantiles[q], histogram_quantile(histogram, quantiles[q]));
+        }
+        fprintf(file, "chaq_sdfgen_stage_seconds_sum{stage=\"%s\"} %.6f\n", stage_names[s],
+                (double)atomic_load_explicit(&histogram->sum_us, memory_order_relaxed) * 1e-6);
+        fprintf(file, "chaq_sdfgen_stage_seconds_count{stage=\"%s\"} %llu\n", stage_names[s],
+                (unsigned long long)atomic_load_explicit(&histogram->count, memory_order_relaxed));
+    }
+    fputs("# HELP chaq_sdfgen_stage_seconds_max Longest latency of each stage of a job.\n"
+          "# TYPE chaq_sdfgen_stage_seconds_max gauge\n",
+          file);
+    for (size_t s = 0; s < METRICS_STAGES; ++s) {
+        fprintf(file, "chaq_sdfgen_stage_seconds_max{stage=\"%s\"} %.6f\n", stage_names[s],
+                histogram_max(&metrics->stages[s]));
+    }
+
+    uint64_t completed = atomic_load_explicit(&metrics->completed, memory_order_relaxed);
+    double elapsed = omp_get_wtime() - metrics->start;
+    fprintf(file,
+            "# HELP chaq_sdfgen_jobs_total Jobs finished, by result.\n"
+            "# TYPE chaq_sdfgen_jobs_total counter\n"
+            "chaq_sdfgen_jobs_total{result=\"ok\"} %llu\n"
+            "chaq_sdfgen_jobs_total{result=\"error\"} %llu\n"
+            "# HELP chaq_sdfgen_images_per_second Images completed per second since the start.\n"
+            "# TYPE chaq_sdfgen_images_per_second gauge\n"
+            "chaq_sdfgen_images_per_second %.3f\n"
+            "# HELP chaq_sdfgen_uptime_seconds Seconds since the start.\n"
+            "# TYPE chaq_sdfgen_uptime_seconds gauge\n"
+            "chaq_sdfgen_uptime_seconds %.3f\n",
+            (unsigned long long)completed,
+            (unsigned long long)atomic_load_explicit(&metrics->failed, memory_order_relaxed),
+            elapsed > 0.0 ? (double)completed / elapsed : 0.0, elapsed);
+    for (size_t i = 0; i < n_extra; ++i) {
+        fprintf(file, "# HELP chaq_sdfgen_%s %s\n# TYPE chaq_sdfgen_%s counter\nchaq_sdfgen_%s %llu\n", extra[i].name,
+                extra[i].help, extra[i].name, extra[i].name, (unsigned long long)extra[i].value);
+    }
+
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    // rename does not replace an existing file everywhere
+    if (ok && rename(temp_path, path) != 0) ok = remove(path) == 0 && rename(temp_path, path) == 0;
+    if (!ok) remove(temp_path);
+    return ok;
+}
+
+bool metrics_update(struct metrics* metrics, const struct metrics_counter* extra, size_t n_extra, bool force) {
+    if (metrics->path == NULL) return true;
+    double now = omp_get_wtime();
+    if (!force && now - metrics->last_write < metrics->interval) return true;
+    metrics->last_write = now;
+    return metrics_write(metrics, metrics->path, extra, n_extra);
+}
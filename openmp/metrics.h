@@ -0,0 +1,75 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Latency statistics of many jobs run by one process, for the sequence and service modes
+
+// stages of a job, total spans all of them
+enum STAGE { ST_NONE = -1, ST_QUEUE, ST_DECODE, ST_COMPUTE, ST_ENCODE, ST_TOTAL };
+
+#define METRICS_STAGES (ST_TOTAL + 1)
+
+// HDR-style histogram of microseconds: values below 2 * 2^HISTOGRAM_SUB_BITS get a bucket each, larger ones
+// 2^HISTOGRAM_SUB_BITS buckets per power of two, so any value is kept to within about 3% up to 2^32 us (71 minutes)
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// recorded without locks, by any number of threads
+struct histogram {
+    atomic_uint_fast64_t counts[HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum_us;
+    atomic_uint_fast64_t max_us;
+};
+
+struct metrics {
+    struct histogram stages[METRICS_STAGES];
+    atomic_uint_fast64_t completed;
+    atomic_uint_fast64_t failed;
+    // omp_get_wtime when collection started
+    double start;
+    // Prometheus text file rewritten by metrics_update at most every interval seconds, NULL for none
+    const char* path;
+    double interval;
+    double last_write;
+};
+
+// additional counter written with the metrics, name without the chaq_sdfgen_ prefix
+struct metrics_counter {
+    const char* name;
+    const char* help;
+    uint64_t value;
+};
+
+void metrics_init(struct metrics* metrics, const char* path, double interval);
+
+// adds seconds spent in stage by one job
+void metrics_record(struct metrics* metrics, enum STAGE stage, double seconds);
+
+// records the time since *t in stage unless metrics is NULL, and restarts *t
+void metrics_lap(struct metrics* metrics, enum STAGE stage, double* t);
+
+// counts a finished job, its total latency is recorded separately
+void metrics_job_done(struct metrics* metrics, bool ok);
+
+// value below which fraction q of the recorded values lie, in seconds, 0 if none were recorded
+double histogram_quantile(const struct histogram* histogram, double q);
+
+// prints a table of p50/p90/p99/max per stage and the throughput
+void metrics_print(const struct metrics* metrics, FILE* stream);
+
+// Writes the metrics in the Prometheus text exposition format, replacing path through a temporary file so readers
+// never see a partial one. Returns false if it could not be written.
+bool metrics_write(const struct metrics* metrics, const char* path, const struct metrics_counter* extra,
+                   size_t n_extra);
+
+// Writes the metrics file if one was given and interval has passed since the last write, or always if force.
+// Not thread safe, callers serialize calls.
+bool metrics_update(struct metrics* metrics, const struct metrics_counter* extra, size_t n_extra, bool force);
+
+#endif
@@ -0,0 +1,252 @@
+// Performance regression checks run by CTest, timing fixed synthetic inputs against a checked-in baseline
+// usage: chaq_sdfgen_perf case baseline.json [runs]
+//        chaq_sdfgen_perf --update baseline.json [runs]
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "df.h"
+#include "sdf.h"
+
+#define PERF_SIZE 2048
+#define PERF_SPREAD 32
+#define PERF_RUNS 7
+#define PERF_TOLERANCE 0.3
+
+// grey-alpha image of discs of varying size on a jittered grid with speckles, the same on every run
+static unsigned char* synthetic_image(size_t w, size_t h) {
+    unsigned char* img = malloc(w * h * 2);
+    if (img == NULL) return NULL;
+
+    uint32_t state = 12345;
+    for (size_t y = 0; y < h; ++y) {
+        for (size_t x = 0; x < w; ++x) {
+            size_t cx = (x / 64) * 64 + 32;
+            size_t cy = (y / 64) * 64 + 32;
+            float r = 8.f + (float)((cx * 7 + cy * 13) % 24);
+            float dx = (float)x - (float)cx;
+            float dy = (float)y - (float)cy;
+            state = state * 1664525u + 1013904223u;
+            bool speckle = (state >> 24) < 2;
+            bool inside = dx * dx + dy * dy < r * r;
+            unsigned char v = (inside != speckle) ? 255 : 0;
+            img[(y * w + x) * 2] = v;
+            img[(y * w + x) * 2 + 1] = v;
+        }
+    }
+    return img;
+}
+
+struct perf_input {
+    const unsigned char* img;
+    const bool* mask;
+    size_t w;
+    size_t h;
+    float* inside;
+    float* outside;
+    unsigned char* out;
+};
+
+// times both fields of one engine, the way the generator runs it
+static double time_engine(const struct perf_input* in, const char* engine_name) {
+    const struct df_engine* engine = df_find_engine(engine_name);
+    size_t n = in->w * in->h;
+    for (size_t i = 0; i < n; ++i) {
+        in->inside[i] = in->mask[i] ? 0.f : INFINITY;
+        in->outside[i] = in->mask[i] ? INFINITY : 0.f;
+    }
+
+    double t_start = omp_get_wtime();
+    engine->transform_2d(in->inside, in->w, in->h, NULL);
+    engine->transform_2d(in->outside, in->w, in->h, NULL);
+    return omp_get_wtime() - t_start;
+}
+
+static double run_fh(const struct perf_input* in) { return time_engine(in, "fh"); }
+
+// both fields through the fused transform, straight from the mask
+static double run_fh_dual(const struct perf_input* in) {
+    double t_start = omp_get_wtime();
+    dist_transform_2d_dual(in->mask, in->inside, in->outside, in->w, in->h, NULL);
+    return omp_get_wtime() - t_start;
+}
+
+static double run_meijster(const struct perf_input* in) { return time_engine(in, "meijster"); }
+
+// mask from image through to output pixels, everything but decoding and encoding
+static double run_pipeline(const struct perf_input* in) {
+    struct sdf_params params = {df_find_engine("fh"), PERF_SPREAD, false, NULL, 0, GR_DISTANCE, BD_CLIP, 0, 0, 0, 0, 0,
+                                NULL};
+    bool* mask = malloc(in->w * in->h * sizeof(bool));
+    if (mask == NULL) return INFINITY;
+
+    double t_start = omp_get_wtime();
+    sdf_mask_from_image(in->img, mask, in->w, in->h, 2, 1, 127, true);
+    bool ok = sdf_generate(mask, in->w, in->h, &params, in->out);
+    double t = omp_get_wtime() - t_start;
+
+    free(mask);
+    return ok ? t : INFINITY;
+}
+
+struct perf_case {
+    const char* name;
+    double (*run)(const struct perf_input* in);
+};
+
+static const struct perf_case cases[] = {
+    {"dist_transform_2d", run_fh},
+    {"dist_transform_2d_dual", run_fh_dual},
+    {"dist_transform_2d_meijster", run_meijster},
+    {"pipeline", run_pipeline},
+};
+static const size_t n_cases = sizeof(cases) / sizeof(cases[0]);
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// median time of runs in milliseconds, after one warm-up run
+static double median_ms(const struct perf_case* c, const struct perf_input* in, size_t runs) {
+    double times[64];
+    runs = runs > 64 ? 64 : runs;
+    c->run(in);
+    for (size_t run = 0; run < runs; ++run) times[run] = c->run(in);
+    qsort(times, runs, sizeof(double), compare_double);
+    return times[runs / 2] * 1000.0;
+}
+
+// reads "name": {"median_ms": x, "tolerance": y} from the baseline, returns false if name has no entry
+static bool read_baseline(const char* json, const char* name, double* median_out, double* tolerance_out) {
+    char key[128];
+    snprintf(key, sizeof(key), "\"%s\"", name);
+    const char* entry = strstr(json, key);
+    if (entry == NULL) return false;
+    const char* end = strchr(entry, '}');
+    const char* median = strstr(entry, "\"median_ms\"");
+    const char* tolerance = strstr(entry, "\"tolerance\"");
+    if (median == NULL || end == NULL || median > end) return false;
+
+    *median_out = strtod(strchr(median, ':') + 1, NULL);
+    *tolerance_out = tolerance != NULL && tolerance < end ? strtod(strchr(tolerance, ':') + 1, NULL) : PERF_TOLERANCE;
+    return *median_out > 0.0;
+}
+
+// reads the top level "threads" the baseline was recorded with, 0 if it has none
+static int read_baseline_threads(const char* json) {
+    const char* threads = strstr(json, "\"threads\"");
+    return threads != NULL ? (int)strtol(strchr(threads, ':') + 1, NULL, 10) : 0;
+}
+
+static char* read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text != NULL) {
+        size_t n_read = fread(text, 1, (size_t)size, file);
+        text[n_read] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fputs("usage: chaq_sdfgen_perf case|--update baseline.json [runs]\n", stderr);
+        return 2;
+    }
+    bool update = strcmp(argv[1], "--update") == 0;
+    const char* baseline_path = argv[2];
+    size_t runs = argc > 3 ? strtoull(argv[3], NULL, 10) : PERF_RUNS;
+    if (runs == 0) runs = PERF_RUNS;
+
+    const struct perf_case* selected = NULL;
+    for (size_t c = 0; c < n_cases; ++c) {
+        if (strcmp(cases[c].name, argv[1]) == 0) selected = &cases[c];
+    }
+    if (!update && selected == NULL) {
+        fprintf(stderr, "Unknown case \"%s\".\n", argv[1]);
+        return 2;
+    }
+
+    size_t w = PERF_SIZE;
+    size_t h = PERF_SIZE;
+    unsigned char* img = synthetic_image(w, h);
+    bool* mask = malloc(w * h * sizeof(bool));
+    float* inside = malloc(w * h * sizeof(float));
+    float* outside = malloc(w * h * sizeof(float));
+    unsigned char* out = malloc(w * h);
+    if (img == NULL || mask == NULL || inside == NULL || outside == NULL || out == NULL) {
+        fputs("Perf buffers could not be allocated.\n", stderr);
+        return 2;
+    }
+    sdf_mask_from_image(img, mask, w, h, 2, 1, 127, true);
+    struct perf_input in = {img, mask, w, h, inside, outside, out};
+
+    int status = 0;
+    if (update) {
+        // measures every case on this machine and replaces the baseline
+        FILE* file = fopen(baseline_path, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Baseline \"%s\" could not be written.\n", baseline_path);
+            return 2;
+        }
+        fprintf(file, "{\n    \"size\": %d,\n    \"threads\": %d", PERF_SIZE, omp_get_max_threads());
+        for (size_t c = 0; c < n_cases; ++c) {
+            double ms = median_ms(&cases[c], &in, runs);
+            printf("%-28s %10.3f ms\n", cases[c].name, ms);
+            fprintf(file, ",\n    \"%s\": {\"median_ms\": %.3f, \"tolerance\": %.2f}", cases[c].name, ms,
+                    PERF_TOLERANCE);
+        }
+        fputs("\n}\n", file);
+        fclose(file);
+    } else {
+        char* json = read_file(baseline_path);
+        double baseline_ms;
+        double tolerance;
+        if (json == NULL || !read_baseline(json, selected->name, &baseline_ms, &tolerance)) {
+            fprintf(stderr, "No baseline for %s in \"%s\", record one with --update.\n", selected->name, baseline_path);
+            free(json);
+            return 2;
+        }
+        // times only compare on as many threads as the baseline ran on
+        int threads = read_baseline_threads(json);
+        free(json);
+        if (threads <= 0 || threads > omp_get_max_threads()) {
+            fprintf(stderr, "Baseline \"%s\" recorded with %d threads, %d available, record one with --update.\n",
+                    baseline_path, threads, omp_get_max_threads());
+            return 2;
+        }
+        omp_set_num_threads(threads);
+
+        double ms = median_ms(selected, &in, runs);
+        double change = ms / baseline_ms - 1.0;
+        bool regressed = change > tolerance;
+        printf("%s: median %.3f ms of %zu runs, baseline %.3f ms, %+.1f%% (limit %+.1f%%)\n", selected->name, ms, runs,
+               baseline_ms, change * 100.0, tolerance * 100.0);
+        if (regressed) {
+            printf("REGRESSION: %s is %.1f%% slower than its baseline\n", selected->name, change * 100.0);
+            status = 1;
+        } else if (change < -tolerance) {
+            printf("%s is well below its baseline, consider recording a new one with --update\n", selected->name);
+        }
+    }
+
+    free(out);
+    free(outside);
+    free(inside);
+    free(mask);
+    free(img);
+    return status;
+}
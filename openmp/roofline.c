@@ -0,0 +1,141 @@
+#include "roofline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <omp.h>
+
+#include "df.h"
+
+#define STREAM_FLOATS (8 << 20)
+#define STREAM_RUNS 5
+#define STAGE_RUNS 5
+
+// best STREAM triad bandwidth in bytes per second, counting the two arrays read and the one written
+static double stream_triad(void) {
+    float* a = malloc(STREAM_FLOATS * sizeof(float));
+    float* b = malloc(STREAM_FLOATS * sizeof(float));
+    float* c = malloc(STREAM_FLOATS * sizeof(float));
+    double best = 0.0;
+    if (a != NULL && b != NULL && c != NULL) {
+        ptrdiff_t i;
+#pragma omp parallel for schedule(static)
+        for (i = 0; i < (ptrdiff_t)(STREAM_FLOATS); ++i) {
+            a[i] = 0.f;
+            b[i] = 1.f;
+            c[i] = 2.f;
+        }
+
+        for (size_t run = 0; run < STREAM_RUNS; ++run) {
+            double t_start = omp_get_wtime();
+#pragma omp parallel for schedule(static)
+            for (i = 0; i < (ptrdiff_t)(STREAM_FLOATS); ++i) a[i] = b[i] + 3.f * c[i];
+            double t = omp_get_wtime() - t_start;
+            double bandwidth = 3.0 * STREAM_FLOATS * sizeof(float) / t;
+            best = bandwidth > best ? bandwidth : best;
+        }
+    }
+    free(c);
+    free(b);
+    free(a);
+    return best;
+}
+
+static void count_bytes(void* context, void* data, int size) {
+    (void)data;
+    *(size_t*)context += (size_t)size;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double median(double* times, size_t n) {
+    qsort(times, n, sizeof(double), compare_double);
+    return times[n / 2];
+}
+
+// one stage of the pipeline, bytes and operations are per pixel of the image
+struct stage {
+    const char* name;
+    double bytes;
+    double ops;
+    double seconds;
+};
+
+bool roofline_report(const unsigned char* img, size_t w, size_t h, size_t stride, size_t offset,
+                     unsigned char threshold, bool test_above, const struct sdf_params* params,
+                     enum FILETYPE filetype) {
+    size_t n = w * h;
+    size_t channels = sdf_channels(params);
+    bool* mask = malloc(n * sizeof(bool));
+    float* inside = malloc(n * sizeof(float));
+    float* outside = malloc(n * sizeof(float));
+    float* pair_tpose = malloc(2 * n * sizeof(float));
+    unsigned char* out = malloc(n * channels);
+    bool ok = mask != NULL && inside != NULL && outside != NULL && pair_tpose != NULL && out != NULL;
+
+    if (ok) {
+        double peak = stream_triad();
+        printf("stream triad: %.2f GB/s (best of %d runs over 3 x %d MiB, %d threads)\n", peak * 1e-9, STREAM_RUNS,
+               (int)(STREAM_FLOATS * sizeof(float) >> 20), omp_get_max_threads());
+
+        // Bytes count what each stage reads and writes of its buffers, scratch that stays in cache is left out.
+        // Operations are approximate counts of arithmetic, comparisons and selects per pixel.
+        struct stage stages[] = {
+            {"threshold", (double)stride + 1.0, 1.0, 0.0},
+            {"row pass", 2.0 * 1.0 + 2.0 * 2.0 * 4.0 + 2.0 * 4.0, 2.0 * 8.0, 0.0},
+            {"column pass", 2.0 * 4.0 + 2.0 * 4.0, 2.0 * 15.0, 0.0},
+            {"subtract", 4.0 + 4.0 + 4.0, 3.0, 0.0},
+            {"remap", 4.0 + (double)channels, 6.0, 0.0},
+            {"encode", (double)channels, 0.0, 0.0},
+        };
+        size_t n_stages = sizeof(stages) / sizeof(stages[0]);
+        size_t encoded_size = 0;
+        double times[STAGE_RUNS];
+
+        for (size_t s = 0; s < n_stages; ++s) {
+            for (size_t run = 0; run < STAGE_RUNS; ++run) {
+                // the subtraction works in place, every run starts from the transformed fields
+                if (s == 3) dist_transform_axis_dual(pair_tpose, h, w, inside, outside, true, NULL);
+                encoded_size = 0;
+
+                double t_start = omp_get_wtime();
+                switch (s) {
+                case 0: sdf_mask_from_image(img, mask, w, h, stride, offset, threshold, test_above); break;
+                case 1: dist_transform_binary_rows_dual(mask, w, h, pair_tpose, NULL); break;
+                case 2: dist_transform_axis_dual(pair_tpose, h, w, inside, outside, true, NULL); break;
+                case 3: sdf_combine_fields(outside, inside, w, h, params); break;
+                case 4: sdf_encode_field(outside, w, h, params, out); break;
+                case 5:
+                    encode_image(count_bytes, &encoded_size, filetype, (int)w, (int)h, (int)channels, out, 100);
+                    break;
+                }
+                times[run] = omp_get_wtime() - t_start;
+            }
+            stages[s].seconds = median(times, STAGE_RUNS);
+        }
+        stages[n_stages - 1].bytes += (double)encoded_size / (double)n;
+
+        printf("%zux%zu, median of %d runs per stage\n", w, h, STAGE_RUNS);
+        printf("%-12s %10s %8s %8s %8s %8s %8s\n", "stage", "time (ms)", "B/px", "ops/px", "ops/B", "GB/s", "of peak");
+        double total = 0.0;
+        for (size_t s = 0; s < n_stages; ++s) {
+            const struct stage* stage = &stages[s];
+            double bandwidth = stage->bytes * (double)n / stage->seconds;
+            total += stage->seconds;
+            printf("%-12s %10.3f %8.1f %8.1f %8.2f %8.2f %7.1f%%\n", stage->name, stage->seconds * 1000.0,
+                   stage->bytes, stage->ops, stage->ops / stage->bytes, bandwidth * 1e-9, 100.0 * bandwidth / peak);
+        }
+        printf("%-12s %10.3f\n", "total", total * 1000.0);
+    }
+
+    free(out);
+    free(pair_tpose);
+    free(outside);
+    free(inside);
+    free(mask);
+    return ok;
+}
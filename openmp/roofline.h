@@ -0,0 +1,18 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image.h"
+#include "sdf.h"
+
+// Measures achievable memory bandwidth with a STREAM triad, then times every stage of generating the field of img
+// with the default engine and prints the bytes and operations each moves per pixel, its bandwidth and its fraction of
+// the measured peak. Returns false if a buffer could not be allocated.
+// stride, offset -- layout of img and the channel tested, as for sdf_mask_from_image
+bool roofline_report(const unsigned char* img, size_t w, size_t h, size_t stride, size_t offset,
+                     unsigned char threshold, bool test_above, const struct sdf_params* params,
+                     enum FILETYPE filetype);
+
+#endif
@@ -0,0 +1,366 @@
+#include "sdf.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "trace.h"
+
+// transforms input image data into boolean buffers, one per threshold
+void sdf_masks_from_image(const unsigned char* restrict img_in, bool* const* bool_outs, const unsigned char* thresholds,
+                          size_t n_thresholds, size_t width, size_t height, size_t stride, size_t offset,
+                          bool test_above) {
+    // rows are tested against every threshold while they are in cache
+    ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < (ptrdiff_t)(height); ++y) {
+        const unsigned char* restrict row = img_in + (size_t)y * width * stride + offset;
+        for (size_t t = 0; t < n_thresholds; ++t) {
+            bool* restrict bool_out = bool_outs[t] + (size_t)y * width;
+            unsigned char threshold = thresholds[t];
+            if (test_above) {
+                for (size_t x = 0; x < width; ++x) bool_out[x] = row[x * stride] > threshold;
+            } else {
+                for (size_t x = 0; x < width; ++x) bool_out[x] = row[x * stride] < threshold;
+            }
+        }
+    }
+}
+
+void sdf_mask_from_image(const unsigned char* img_in, bool* bool_out, size_t width, size_t height, size_t stride,
+                         size_t offset, unsigned char threshold, bool test_above) {
+    sdf_masks_from_image(img_in, &bool_out, &threshold, 1, width, height, stride, offset, test_above);
+}
+
+// transforms boolean buffer to float buffer
+static void transform_bool_to_float(const bool* restrict bool_in, float* restrict float_out, size_t width,
+                                    size_t height, bool true_is_zero) {
+    ptrdiff_t i;
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < (ptrdiff_t)(width * height); ++i) {
+        float_out[i] = bool_in[(size_t)i] == true_is_zero ? 0.f : INFINITY;
+    }
+}
+
+// clamped linear remap of a distance to a pixel value
+static inline unsigned char distance_to_byte(float v, size_t spread, bool asymmetric) {
+    float s_min = asymmetric ? 0 : -(float)spread;
+    float s_max = (float)spread;
+    float d_min = 0.f;
+    float d_max = 255.f;
+
+    float sn = s_max - s_min;
+    float nd = d_max - d_min;
+
+    v = v > s_max ? s_max : v;
+    v = v < s_min ? s_min : v;
+
+    float remap = (((v - s_min) * nd) / sn) + d_min;
+    return (unsigned char)remap;
+}
+
+// maps [-1,1] to a pixel value, 0 to the middle
+static inline unsigned char unit_to_byte(float v) {
+    float remap = (v + 1.f) * 127.5f + .5f;
+    remap = remap > 255.f ? 255.f : remap;
+    remap = remap < 0.f ? 0.f : remap;
+    return (unsigned char)remap;
+}
+
+// single-channel char array output of input floats, for rows [y0,y1)
+static void transform_float_to_byte(const float* restrict float_in, unsigned char* restrict byte_out, size_t width,
+                                    size_t y0, size_t y1, size_t spread, bool asymmetric) {
+    const float* band_in = float_in + y0 * width;
+    ptrdiff_t i;
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < (ptrdiff_t)(width * (y1 - y0)); ++i) {
+        byte_out[(size_t)i] = distance_to_byte(band_in[i], spread, asymmetric);
+    }
+}
+
+// gradient of the field next to the distance, from central differences (one-sided at the edges)
+// rg -- unit gradient of the distance clamped to [-spread, spread] in RG, pointing inside, and the distance in B
+// normal -- normal of the distance clamped to the output range taken as height in RGB, and the distance in A
+// Both clamp so that distances past the spread, which shards, bands and incremental updates only bound, cannot show.
+// Output is for rows [y0,y1), reading one row of float_in beyond them on either side.
+static void transform_float_to_gradient(const float* restrict float_in, unsigned char* restrict byte_out, size_t width,
+                                        size_t height, size_t y0, size_t y1, size_t spread, bool asymmetric,
+                                        enum GRADIENT gradient) {
+    size_t channels = gradient == GR_RG ? 3 : 4;
+    // directions stay meaningful inside even when asymmetric output drops the inside distances
+    float s_min = asymmetric && gradient == GR_NORMAL ? 0 : -(float)spread;
+    float s_max = (float)spread;
+
+    ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = (ptrdiff_t)(y0); y < (ptrdiff_t)(y1); ++y) {
+        size_t y_above = y > 0 ? (size_t)y - 1 : 0;
+        size_t y_below = (size_t)y + 1 < height ? (size_t)y + 1 : height - 1;
+        const float* row = float_in + (size_t)y * width;
+        const float* row_above = float_in + y_above * width;
+        const float* row_below = float_in + y_below * width;
+
+        for (size_t x = 0; x < width; ++x) {
+            size_t x0 = x > 0 ? x - 1 : 0;
+            size_t x1 = x + 1 < width ? x + 1 : width - 1;
+            float l = row[x0];
+            float r = row[x1];
+            float u = row_above[x];
+            float d = row_below[x];
+            l = l > s_max ? s_max : (l < s_min ? s_min : l);
+            r = r > s_max ? s_max : (r < s_min ? s_min : r);
+            u = u > s_max ? s_max : (u < s_min ? s_min : u);
+            d = d > s_max ? s_max : (d < s_min ? s_min : d);
+            float gx = x1 > x0 ? (r - l) / (float)(x1 - x0) : 0.f;
+            float gy = y_below > y_above ? (d - u) / (float)(y_below - y_above) : 0.f;
+
+            unsigned char* out = byte_out + (((size_t)y - y0) * width + x) * channels;
+            if (gradient == GR_RG) {
+                float len = sqrtf(gx * gx + gy * gy);
+                out[0] = unit_to_byte(len > 0.f ? gx / len : 0.f);
+                out[1] = unit_to_byte(len > 0.f ? gy / len : 0.f);
+                out[2] = distance_to_byte(row[x], spread, asymmetric);
+            } else {
+                float len = sqrtf(gx * gx + gy * gy + 1.f);
+                out[0] = unit_to_byte(-gx / len);
+                out[1] = unit_to_byte(-gy / len);
+                out[2] = unit_to_byte(1.f / len);
+                out[3] = distance_to_byte(row[x], spread, asymmetric);
+            }
+        }
+    }
+}
+
+// distance to the nearest pixel beyond the image border, which lies on one of the virtual site lines at -1 and
+// width (or height), moved out by the padding
+static float border_distance(size_t x, size_t y, const struct sdf_params* params, size_t width, size_t height) {
+    bool whole = params->frame_width == 0;
+    float fx = whole ? (float)x : (float)(params->frame_x + x);
+    float fy = whole ? (float)y : (float)(params->frame_y + y);
+    float fw = whole ? (float)width : (float)params->frame_width;
+    float fh = whole ? (float)height : (float)params->frame_height;
+    float dx = fx + 1.f < fw - fx ? fx + 1.f : fw - fx;
+    float dy = fy + 1.f < fh - fy ? fy + 1.f : fh - fy;
+    float pad = params->border == BD_PAD ? (float)params->border_pad : 0.f;
+    return (dx < dy ? dx : dy) + pad;
+}
+
+// consolidates (outside - inside) into float_dst, applying the border to whichever field it adds sites to
+// replicated edge pixels are never nearer than the edge itself, so pad only moves the outside sites out
+// Both fields hold rows [y0,y1) of an image of the given height, starting at row y0.
+static void transform_float_sub(float* restrict float_dst, float* restrict float_by, size_t width, size_t height,
+                                size_t y0, size_t y1, const struct sdf_params* params) {
+    bool border_inside = params->border == BD_INSIDE;
+    bool border_outside = params->border == BD_OUTSIDE || params->border == BD_PAD;
+
+    ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = (ptrdiff_t)(y0); y < (ptrdiff_t)(y1); ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            size_t i = ((size_t)y - y0) * width + x;
+            float inside = float_by[i];
+            float outside = float_dst[i];
+            if (border_inside || border_outside) {
+                // the virtual sites are a pointwise minimum over the transformed field
+                float border = border_distance(x, (size_t)y, params, width, height);
+                if (border_inside) inside = border < inside ? border : inside;
+                if (border_outside) outside = border < outside ? border : outside;
+            }
+
+            float bias = -1.f;
+            float val = inside > 0.f ? inside + bias : inside;
+            float_dst[i] = outside - val;
+        }
+    }
+}
+
+enum GRADIENT read_gradient(const char* string) {
+    if (strcmp(string, "rg") == 0) return GR_RG;
+    if (strcmp(string, "normal") == 0) return GR_NORMAL;
+    return GR_NONE;
+}
+
+enum BORDER read_border(const char* string, size_t* pad_out) {
+    *pad_out = 0;
+    if (strcmp(string, "clip") == 0) return BD_CLIP;
+    if (strcmp(string, "inside") == 0) return BD_INSIDE;
+    if (strcmp(string, "outside") == 0) return BD_OUTSIDE;
+    if (strncmp(string, "pad:", 4) == 0) {
+        char* end;
+        unsigned long long pad = strtoull(string + 4, &end, 10);
+        if (end == string + 4 || *end != '\0') return BD_NONE;
+        *pad_out = (size_t)pad;
+        return BD_PAD;
+    }
+    return BD_NONE;
+}
+
+size_t sdf_channels(const struct sdf_params* params) {
+    if (params->n_effects > 0 || params->gradient == GR_NORMAL) return 4;
+    return params->gradient == GR_RG ? 3 : 1;
+}
+
+size_t sdf_reach(const struct sdf_params* params) {
+    // distances saturate one pixel past the spread on the outside
+    size_t reach = params->n_effects > 0 ? effect_reach(params->effects, params->n_effects) : params->spread;
+    return reach + 2;
+}
+
+size_t sdf_footprint(size_t width, size_t height, const struct sdf_params* params) {
+    // both float fields, the workspace of a transform pair (transposed or interleaved, two floats a pixel for the fused
+    // and the separable engines, less for the others) and the output pixels
+    return width * height * (4 * sizeof(float) + sdf_channels(params));
+}
+
+void sdf_combine_fields(float* outside, float* inside, size_t width, size_t height, const struct sdf_params* params) {
+    transform_float_sub(outside, inside, width, height, 0, height, params);
+}
+
+void sdf_encode_rows(const float* field, size_t width, size_t height, size_t y0, size_t y1,
+                     const struct sdf_params* params, unsigned char* byte_out) {
+    if (params->n_effects > 0) {
+        effects_render(field, width, height, y0, y1, params->effects, params->n_effects, byte_out);
+    } else if (params->gradient != GR_DISTANCE) {
+        transform_float_to_gradient(field, byte_out, width, height, y0, y1, params->spread, params->asymmetric,
+                                    params->gradient);
+    } else {
+        transform_float_to_byte(field, byte_out, width, y0, y1, params->spread, params->asymmetric);
+    }
+}
+
+void sdf_encode_field(const float* field, size_t width, size_t height, const struct sdf_params* params,
+                      unsigned char* byte_out) {
+    sdf_encode_rows(field, width, height, 0, height, params, byte_out);
+}
+
+bool sdf_generate_stack(const bool* const* masks, size_t n_masks, size_t width, size_t height,
+                        const struct sdf_params* params, unsigned char* const* byte_outs) {
+    // compute 2d sdf images, for mask i
+    // fields[2i] -- pixel distance to INSIDE
+    // fields[2i+1] -- pixel distance to OUTSIDE
+    size_t n_fields = 2 * n_masks;
+    float** fields = calloc(n_fields, sizeof(float*));
+    bool ok = fields != NULL;
+    for (size_t f = 0; ok && f < n_fields; ++f) {
+        ok = (fields[f] = malloc(width * height * sizeof(float))) != NULL;
+    }
+
+    struct df_control* control = params->control;
+    df_control_start(control, n_fields * df_work(width, height));
+
+    if (ok) {
+        // a fused engine transforms both fields of a mask at once, otherwise each field is a transform of its own
+        const struct df_engine* engine = params->engine;
+        bool dual = engine->transform_2d_dual != NULL;
+        size_t n_jobs = dual ? n_masks : n_fields;
+
+        // the jobs split the threads between them, each transform runs its own loops on its share
+        int max_threads = omp_get_max_threads();
+        int outer_threads = (int)n_jobs < max_threads ? (int)n_jobs : max_threads;
+        int inner_threads = max_threads / outer_threads;
+
+        ptrdiff_t j;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(outer_threads)
+        for (j = 0; j < (ptrdiff_t)(n_jobs); ++j) {
+            omp_set_num_threads(inner_threads);
+            TRACE_BEGIN(job, "transform");
+            // a cancelled transform returns early, the check below catches it
+            if (dual) {
+                engine->transform_2d_dual(masks[j], fields[2 * j], fields[2 * j + 1], width, height, control);
+            } else {
+                transform_bool_to_float(masks[j / 2], fields[j], width, height, j % 2 == 0);
+                engine->transform_2d(fields[j], width, height, control);
+            }
+            TRACE_END_INDEX(job, j);
+        }
+
+        ok = !df_cancelled(control);
+        for (size_t m = 0; ok && m < n_masks; ++m) {
+            TRACE_BEGIN(encode, "combine_encode");
+            // consolidate in the form of (outside - inside)
+            transform_float_sub(fields[2 * m + 1], fields[2 * m], width, height, 0, height, params);
+            // transform distance values to pixel values
+            sdf_encode_field(fields[2 * m + 1], width, height, params, byte_outs[m]);
+            TRACE_END_INDEX(encode, m);
+        }
+    }
+
+    if (fields != NULL) {
+        for (size_t f = 0; f < n_fields; ++f) free(fields[f]);
+    }
+    free(fields);
+    return ok;
+}
+
+bool sdf_generate(const bool* mask, size_t width, size_t height, const struct sdf_params* params,
+                  unsigned char* byte_out) {
+    return sdf_generate_stack(&mask, 1, width, height, params, &byte_out);
+}
+
+bool sdf_generate_streamed(const bool* mask, size_t width, size_t height, const struct sdf_params* params,
+                           size_t band_rows, sdf_band_fn emit, void* context) {
+    // rows past a band that encoding it reads, the band is held back until those are done too
+    size_t halo = params->n_effects > 0 ? effect_row_halo(params->effects, params->n_effects)
+                                        : (params->gradient != GR_DISTANCE ? 1 : 0);
+    size_t channels = sdf_channels(params);
+
+    // column distances of both fields, interleaved, then the signed field as its rows complete
+    float* pair = malloc(2 * width * height * sizeof(float));
+    float* field = malloc(width * height * sizeof(float));
+    float* inside = malloc(band_rows * width * sizeof(float));
+    unsigned char* band_bytes = malloc(band_rows * width * channels);
+    bool ok = pair != NULL && field != NULL && inside != NULL && band_bytes != NULL;
+
+    // both passes transform both fields
+    struct df_control* control = params->control;
+    df_control_start(control, 2 * df_work(width, height));
+
+    if (ok) {
+        // the column pass goes first, so that each row pass completes a row of the output
+        ok = dist_transform_binary_columns_dual(mask, width, height, pair, control);
+
+        // each step transforms the next band while a thread share encodes and emits one whose rows, halo included,
+        // were done in earlier steps
+        int max_threads = omp_get_max_threads();
+        int encode_threads = max_threads / 4 > 1 ? max_threads / 4 : 1;
+        int transform_threads = max_threads > encode_threads ? max_threads - encode_threads : 1;
+        size_t y_done = 0;
+        size_t y_emitted = 0;
+        while (ok && y_emitted < height) {
+            size_t t1 = y_done + band_rows < height ? y_done + band_rows : height;
+            size_t e1 = y_emitted + band_rows < height ? y_emitted + band_rows : height;
+            bool emitting = y_done == height || y_done >= e1 + halo;
+            bool transformed = true;
+            bool emitted = true;
+#pragma omp parallel sections num_threads(max_threads > 1 ? 2 : 1)
+            {
+#pragma omp section
+                if (t1 > y_done) {
+                    omp_set_num_threads(transform_threads);
+                    float* outside = field + y_done * width;
+                    transformed = dist_transform_rows_dual(pair, width, y_done, t1, inside, outside, control);
+                    if (transformed) transform_float_sub(outside, inside, width, height, y_done, t1, params);
+                }
+#pragma omp section
+                if (emitting) {
+                    omp_set_num_threads(encode_threads);
+                    TRACE_BEGIN(band, "emit_band");
+                    sdf_encode_rows(field, width, height, y_emitted, e1, params, band_bytes);
+                    emitted = emit(context, band_bytes, y_emitted, e1 - y_emitted);
+                    TRACE_END_INDEX(band, y_emitted);
+                }
+            }
+            ok = transformed && emitted;
+            y_done = t1;
+            y_emitted = emitting ? e1 : y_emitted;
+        }
+    }
+
+    free(band_bytes);
+    free(inside);
+    free(field);
+    free(pair);
+    return ok && !df_cancelled(control);
+}
@@ -0,0 +1,98 @@
+#ifndef SDF_H
+#define SDF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "df.h"
+#include "effects.h"
+
+// what is output next to the distance
+enum GRADIENT { GR_NONE = -1, GR_DISTANCE, GR_RG, GR_NORMAL };
+
+// what pixels outside the image count as
+enum BORDER { BD_NONE = -1, BD_CLIP, BD_INSIDE, BD_OUTSIDE, BD_PAD };
+
+struct sdf_params {
+    // distance transform engine
+    const struct df_engine* engine;
+    // spread radius in pixels
+    size_t spread;
+    // map [0,spread] instead of [-spread,spread] to the output range
+    bool asymmetric;
+    // effects rendered to RGBA instead of the single channel field, none if n_effects is 0
+    const struct effect* effects;
+    size_t n_effects;
+    // distance only, gradient direction in RG with the distance in B, or a normal map with the distance in A
+    enum GRADIENT gradient;
+    // pixels outside the image are not considered (clip), inside, outside, or the image is extended by border_pad
+    // pixels of edge replication with outside beyond (pad)
+    enum BORDER border;
+    size_t border_pad;
+    // placement of the mask within the image when generating a window of it, the whole image if frame_width is 0
+    size_t frame_x;
+    size_t frame_y;
+    size_t frame_width;
+    size_t frame_height;
+    // optional cancellation and progress of the entry points below, NULL for none. Each call starts a new job on it and
+    // returns false once cancelled, with the output undefined
+    struct df_control* control;
+};
+
+// reads rg or normal
+enum GRADIENT read_gradient(const char* string);
+
+// reads clip, inside, outside or pad:N
+enum BORDER read_border(const char* string, size_t* pad_out);
+
+// channels per output pixel
+size_t sdf_channels(const struct sdf_params* params);
+
+// distance from a changed mask pixel beyond which the output cannot change
+size_t sdf_reach(const struct sdf_params* params);
+
+// bytes sdf_generate holds at its peak for one mask, including the output but not the mask
+size_t sdf_footprint(size_t width, size_t height, const struct sdf_params* params);
+
+// tests one channel of interleaved image data against threshold
+// stride -- bytes per pixel
+// offset -- channel tested within a pixel
+void sdf_mask_from_image(const unsigned char* img, bool* mask, size_t width, size_t height, size_t stride,
+                         size_t offset, unsigned char threshold, bool test_above);
+
+// tests one channel of interleaved image data against each of thresholds in a single pass, into masks[i]
+void sdf_masks_from_image(const unsigned char* img, bool* const* masks, const unsigned char* thresholds,
+                          size_t n_thresholds, size_t width, size_t height, size_t stride, size_t offset,
+                          bool test_above);
+
+// consolidates the distance fields of a mask into the signed field (outside - inside) in outside, applying the border
+void sdf_combine_fields(float* outside, float* inside, size_t width, size_t height, const struct sdf_params* params);
+
+// maps a signed distance field, positive inside, to output pixels sized width*height*sdf_channels(params)
+void sdf_encode_field(const float* field, size_t width, size_t height, const struct sdf_params* params,
+                      unsigned char* byte_out);
+
+// maps rows [y0,y1) of a signed distance field of the given height to output pixels, byte_out holds only those rows
+void sdf_encode_rows(const float* field, size_t width, size_t height, size_t y0, size_t y1,
+                     const struct sdf_params* params, unsigned char* byte_out);
+
+// generates the signed distance field of mask into byte_out, sized width*height*sdf_channels(params)
+// returns false if the working buffers could not be allocated or params->control was cancelled
+bool sdf_generate(const bool* mask, size_t width, size_t height, const struct sdf_params* params,
+                  unsigned char* byte_out);
+
+// generates the fields of n_masks masks into byte_outs[i], transforming all of them on one thread team
+bool sdf_generate_stack(const bool* const* masks, size_t n_masks, size_t width, size_t height,
+                        const struct sdf_params* params, unsigned char* const* byte_outs);
+
+// receives rows [y0,y0+n_rows) of output pixels, returns false to stop generating
+typedef bool (*sdf_band_fn)(void* context, const unsigned char* rows, size_t y0, size_t n_rows);
+
+// generates the signed distance field of mask in bands of band_rows rows, handing each to emit in order once the rows
+// encoding it reads are complete. A band is encoded and emitted on a nested team while the next one is transformed.
+// Uses the exact transform regardless of params->engine.
+// returns false if the working buffers could not be allocated, emit failed or params->control was cancelled
+bool sdf_generate_streamed(const bool* mask, size_t width, size_t height, const struct sdf_params* params,
+                           size_t band_rows, sdf_band_fn emit, void* context);
+
+#endif
@@ -12,15 +12,28 @@
 #include <io.h>
 #endif
 
+#include "backend.h"
+#include "bench.h"
 #include "df.h"
+#include "image.h"
+#include "metrics.h"
+#include "roofline.h"
+#include "sdf.h"
+#include "sequence.h"
+#include "serve.h"
+#include "shard.h"
+#include "shm.h"
+#include "trace.h"
+#include "vector.h"
+
+// rows per band of streamed output
+#define STREAM_BAND_ROWS 64
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
-enum FILETYPE { FT_NONE = -1, FT_PNG, FT_BMP, FT_JPG, FT_TGA };
-
 static void error(const char* str, ...) {
     va_list args;
     va_start(args, str);
@@ -31,92 +44,146 @@ static void error(const char* str, ...) {
 
 static void usage() {
     const char* usage =
-        "usage: chaq_sdfgen [-f filetype] -i file -o file [-q n] [-s n] [-ahln]\n"
+        "usage: chaq_sdfgen [-f filetype] -i file -o file [-q n] [-s n] [-t n | --thresholds n,n,...] [-ahln]\n"
+        "                   [--backend name] [--device name]\n"
+        "       chaq_sdfgen --calibrate [--device name]\n"
+        "       chaq_sdfgen -i file --bench [-ln]\n"
+        "       chaq_sdfgen -i file --roofline [-f filetype] [-s n] [-t n] [-ln]\n"
+        "       chaq_sdfgen --sequence -i pattern|- -o pattern|- [--raw WxH] [--first n] [options]\n"
+        "       chaq_sdfgen --vector file|- --size WxH -o file [--scale f] [options]\n"
+        "       chaq_sdfgen -i file -o file --shard i/N [options]\n"
+        "       chaq_sdfgen -i file -o file.raw --tiled rows [--resume] [options]\n"
+        "       chaq_sdfgen --merge -i pattern -o file\n"
+        "       chaq_sdfgen --list-engines\n"
         "    -f filetype: manually specify filetype among PNG, BMP, TGA, and JPG\n"
         "        (default: deduced by output filename. if not deducable, default is png)\n"
         "    -i file: input file\n"
         "        specify \"-\" to read input from stdin\n"
         "    -o file: output file\n"
         "        specify \"-\" to output to stdout\n"
+        "        specify shm:/name to write the raw result into a POSIX shared memory object, or memfd:label to\n"
+        "        write it into a memfd sent over stdout, which must be a unix socket (see shm.h for the layout)\n"
         "    -q n: jpg quality (default: 100, only relevant for jpeg output)\n"
         "    -s n: spread radius in pixels (default: 64)\n"
         "    -a: asymmetric spread (disregard negative distances, becomes unsinged distance transformation)\n"
         "        (default: symmetric)\n"
         "    -h: show the usage\n"
         "    -l: test pixel based on image luminance (default: tests based on alpha channel)\n"
-        "    -n: invert alpha test; values below threshold will be counted as \"inside\" (default: not inverted)";
-    puts(usage);
+        "    -n: invert alpha test; values below threshold will be counted as \"inside\" (default: not inverted)\n"
+        "    -t n: threshold pixel values are tested against (default: 127)\n";
+    // split to stay within the string length every compiler supports
+    const char* long_usage =
+        "    --thresholds n,n,...: generate a field per threshold from one decode of the input\n"
+        "        up to 4 fields are written as the channels of one image, more need an output pattern such as\n"
+        "        out_%d.png which is given each threshold\n"
+        "    --gradient layout: output the gradient of the field next to the distance\n"
+        "        rg: direction pointing inside in RG, distance in B\n"
+        "        normal: normal map of the distance as height in RGB (y down), distance in A\n"
+        "    --shard i/N: generate only row band i of N into a shard file, for merging with --merge\n"
+        "    --tiled rows: generate bands of the given number of rows into a raw file (a single shard), recording\n"
+        "        finished bands in a journal next to it\n"
+        "    --resume: continue an interrupted tiled run, generating only bands missing or failing their checksum\n"
+        "    --stream: write the output in bands of rows as they complete, for png (uncompressed), tga or bmp\n"
+        "    --progress: report the progress of the distance transforms on stderr (omp backend)\n"
+        "    --serve: run as a service taking jobs on stdin, one per line, and answering on stdout\n"
+        "        <id> interactive|normal|batch <input> <output> [-s n] [-t n] [-a] [-n] [-l], or cancel <id>\n"
+        "    --serve-memory MiB: memory budget of the jobs admitted at once (default: 4096)\n"
+        "    --serve-jobs n: jobs of each priority running at once (default: 2)\n"
+        "    --serve-cache MiB: size of the cache of results kept for repeated jobs (default: 256, 0 disables it)\n"
+        "    --stats: print latency percentiles by stage and throughput on stderr at exit (sequence, serve)\n"
+        "    --metrics file: write the latency statistics to file in the Prometheus text format (sequence, serve)\n"
+        "    --metrics-interval s: seconds between rewrites of the metrics file (default: 10)\n"
+        "    --trace file: record parallel regions, loop chunks and stages per thread as Chrome trace JSON (omp)\n"
+        "    --merge: assemble shards named by an input pattern such as shard_%d.raw into the output image\n"
+        "    --border mode: what pixels outside the image count as (default: clip, they are not considered)\n"
+        "        inside, outside, or pad:N to extend the image by N pixels of its edge with outside beyond\n"
+        "    --backend name: backend among omp, opencl and auto (default: omp)\n"
+        "        auto predicts the faster backend per image from the stored calibration\n"
+        "    --device name: OpenCL device passed on to the opencl backend\n"
+        "    --calibrate: benchmark both backends and store the cost model used by auto\n"
+        "    --engine name: distance transform engine of the omp backend (default: fh)\n"
+        "    --list-engines: list available engines\n"
+        "    --metric name: distance among l2 (euclidean, default), l1 (manhattan) and linf (chebyshev), computed by\n"
+        "        the first engine of that metric unless --engine picks another (omp backend)\n"
+        "    --quality level: exact (default engine) or preview (approximate chamfer-5-7-11 engine)\n"
+        "    --bench: run every engine on the input and report time and error against the default engine\n"
+        "    --roofline: measure memory bandwidth and report how close each stage of the pipeline gets to it\n"
+        "    --sequence: process a sequence of frames, recomputing only regions whose mask changed\n"
+        "        input and output are printf patterns such as frame_%04d.png, or \"-\" for stdin and stdout\n"
+        "    --raw WxH: sequence frames on stdin are raw 8-bit single channel images of the given size\n"
+        "        output to stdout is then raw as well, otherwise encoded images are written back to back\n"
+        "    --first n: number of the first frame of an input pattern (default: 0)\n"
+        "    --effect spec: render an effect layer from the distance field, output becomes RGBA\n"
+        "        may be repeated, layers are stacked in order with the first at the bottom\n"
+        "        fill:RRGGBB[AA]  outline:W:RRGGBB[AA]  glow:R:RRGGBB[AA]  shadow:DX:DY:R:RRGGBB[AA]\n"
+        "        ramp:D0:D1:RRGGBB[AA]:RRGGBB[AA] (distances in pixels, positive inside)\n"
+        "    --vector file: compute exact distances to SVG path data or a polygon instead of an input image\n"
+        "        coordinates are in output pixels, filled by the nonzero rule\n"
+        "    --size WxH: output size of vector input\n"
+        "    --scale f: scale of vector coordinates (default: 1)";
+    fputs(usage, stdout);
+    puts(long_usage);
 }
 
-// transforms input image data into boolean buffer
-static void transform_img_to_bool(const unsigned char* restrict img_in, bool* restrict bool_out, size_t width,
-                                  size_t height, size_t stride, size_t offset, bool test_above) {
-    ptrdiff_t i;
-#pragma omp parallel for schedule(static)
-    for (i = 0; i < (ptrdiff_t)(width * height); ++i) {
-        unsigned char threshold = 127;
-        bool pixel = test_above ? img_in[(size_t)i * stride + offset] > threshold
-                                : img_in[(size_t)i * stride + offset] < threshold;
-        bool_out[i] = pixel;
+// reads a whole stream into a malloc'd buffer
+static unsigned char* read_stream(FILE* stream, size_t* size_out) {
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    unsigned char* data = malloc(capacity);
+    if (data == NULL) return NULL;
+
+    size_t n_read;
+    while ((n_read = fread(data + size, 1, capacity - size, stream)) > 0) {
+        size += n_read;
+        if (size == capacity) {
+            unsigned char* grown = realloc(data, capacity *= 2);
+            if (grown == NULL) {
+                free(data);
+                return NULL;
+            }
+            data = grown;
+        }
     }
-}
 
-// transforms boolean buffer to float buffer
-static void transform_bool_to_float(const bool* restrict bool_in, float* restrict float_out, size_t width,
-                                    size_t height, bool true_is_zero) {
-    ptrdiff_t i;
-#pragma omp parallel for schedule(static)
-    for (i = 0; i < (ptrdiff_t)(width * height); ++i) {
-        float_out[i] = bool_in[(size_t)i] == true_is_zero ? 0.f : INFINITY;
-    }
+    *size_out = size;
+    return data;
 }
 
-// single-channel char array output of input floats
-static void transform_float_to_byte(const float* restrict float_in, unsigned char* restrict byte_out, size_t width,
-                                    size_t height, size_t spread, bool asymmetric) {
-    ptrdiff_t i;
-#pragma omp parallel for schedule(static)
-    for (i = 0; i < (ptrdiff_t)(width * height); ++i) {
-        // clamped linear remap
-        float s_min = asymmetric ? 0 : -(float)spread;
-        float s_max = (float)spread;
-        float d_min = 0.f;
-        float d_max = 255.f;
-
-        float sn = s_max - s_min;
-        float nd = d_max - d_min;
+// file the trace is written to at exit
+static const char* trace_file = NULL;
 
-        float v = float_in[i];
-        v = v > s_max ? s_max : v;
-        v = v < s_min ? s_min : v;
-
-        float remap = (((v - s_min) * nd) / sn) + d_min;
-        byte_out[(size_t)i] = (unsigned char)remap;
-    }
+static void write_trace(void) {
+    if (!trace_write(trace_file)) fprintf(stderr, "Trace could not be written to \"%s\".\n", trace_file);
 }
 
-static void transform_float_sub(float* restrict float_dst, float* restrict float_by, size_t width, size_t height) {
-    ptrdiff_t i;
-#pragma omp parallel for schedule(static)
-    for (i = 0; i < (ptrdiff_t)(width * height); ++i) {
-        float bias = -1.f;
-        float val = float_by[(size_t)i] > 0.f ? float_by[i] + bias : float_by[(size_t)i];
-        float_dst[(size_t)i] -= val;
-    }
+// prints the progress of a generation on one line of stderr
+static void print_progress(void* context, double fraction) {
+    (void)context;
+    fprintf(stderr, "\r%5.1f%%", fraction * 100.0);
+    if (fraction >= 1.0) fputc('\n', stderr);
 }
 
-static enum FILETYPE read_filetype(const char* string) {
-    const char* type_table[] = {"png", "bmp", "jpg", "tga"};
-    size_t n_types = sizeof(type_table) / sizeof(const char*);
-    for (size_t filetype = 0; filetype < n_types; ++filetype) {
-        if (strncmp(string, type_table[filetype], 3) == 0) return (enum FILETYPE)filetype;
-    }
-    return FT_NONE;
+// hands a band of streamed output to the image_stream in context
+static bool emit_band(void* context, const unsigned char* rows, size_t y0, size_t n_rows) {
+    (void)y0;
+    return image_stream_write_rows(context, rows, (int)n_rows);
 }
 
-static void write_to_stdout(void* context, void* data, int size) {
-    (void)(context);
-    fwrite(data, (size_t)size, 1, stdout);
+// reads a comma separated list of at most max_thresholds thresholds
+static bool read_thresholds(const char* str, unsigned char* thresholds_out, size_t max_thresholds, size_t* n_out) {
+    size_t n = 0;
+    const char* p = str;
+    do {
+        char* end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || value > 255 || n == max_thresholds) return false;
+        thresholds_out[n++] = (unsigned char)value;
+        p = end;
+    } while (*p++ == ',');
+    if (p[-1] != '\0') return false;
+
+    *n_out = n;
+    return true;
 }
 
 int main(int argc, char** argv) {
@@ -126,11 +193,51 @@ int main(int argc, char** argv) {
     char* outfile = NULL;
 
     size_t test_channel = 1;
+    unsigned char thresholds[16] = {127};
+    size_t n_thresholds = 1;
+    bool threshold_stack = false;
+    bool single_threshold = false;
+    size_t shard_index = 0;
+    size_t shard_count = 0;
+    bool merge = false;
+    size_t tile_rows = 0;
+    bool resume = false;
+    bool stream = false;
+    bool progress = false;
+    bool serve = false;
+    size_t serve_memory = 4096;
+    size_t serve_jobs = 2;
+    size_t serve_cache = 256;
+    bool stats = false;
+    const char* metrics_file = NULL;
+    double metrics_interval = 10.0;
+    enum GRADIENT gradient = GR_DISTANCE;
+    enum BORDER border = BD_CLIP;
+    size_t border_pad = 0;
     bool test_above = true;
     bool asymmetric = false;
     size_t spread = 64;
     size_t quality = 100;
     enum FILETYPE filetype = FT_NONE;
+    const char* filetype_arg = NULL;
+    enum BACKEND backend = BE_OMP;
+    const char* device = NULL;
+    bool calibrate = false;
+    const struct df_engine* engine = &df_engines[0];
+    bool engine_chosen = false;
+    enum METRIC metric = MT_NONE;
+    bool bench = false;
+    bool roofline = false;
+    bool sequence = false;
+    size_t raw_width = 0;
+    size_t raw_height = 0;
+    size_t first_frame = 0;
+    struct effect effects[16];
+    size_t n_effects = 0;
+    const char* vector_file = NULL;
+    size_t vector_width = 0;
+    size_t vector_height = 0;
+    float vector_scale = 1.f;
 
     bool output_to_stdout = false;
     bool open_from_stdin = false;
@@ -185,6 +292,14 @@ int main(int argc, char** argv) {
                 error("No number specified with quality.");
             }
             quality = strtoull(argv[i], NULL, 10);
+        } break;
+            // t -- threshold
+        case 't': {
+            if (++i >= argc || !read_thresholds(argv[i], thresholds, 1, &n_thresholds)) {
+                usage();
+                error("Invalid threshold specified.");
+            }
+            single_threshold = true;
         } break;
             // f -- filetype
         case 'f': {
@@ -196,6 +311,196 @@ int main(int argc, char** argv) {
                 usage();
                 error("Invalid filetype specified.");
             }
+            filetype_arg = argv[i];
+        } break;
+            // long options
+        case '-': {
+            const char* name = argv[i] + 2;
+            if (strcmp(name, "backend") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Backend not specified with backend switch.");
+                }
+                if ((backend = read_backend(argv[i])) == BE_NONE) {
+                    usage();
+                    error("Invalid backend specified.");
+                }
+            } else if (strcmp(name, "device") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Device not specified with device switch.");
+                }
+                device = argv[i];
+            } else if (strcmp(name, "calibrate") == 0) {
+                calibrate = true;
+            } else if (strcmp(name, "engine") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Engine not specified with engine switch.");
+                }
+                if ((engine = df_find_engine(argv[i])) == NULL) {
+                    usage();
+                    error("Invalid engine specified, see --list-engines.");
+                }
+                engine_chosen = true;
+            } else if (strcmp(name, "quality") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Quality level not specified with quality switch.");
+                }
+                if (strcmp(argv[i], "exact") == 0) {
+                    engine = &df_engines[0];
+                } else if (strcmp(argv[i], "preview") == 0) {
+                    engine = df_find_engine("chamfer-5-7-11");
+                } else {
+                    usage();
+                    error("Invalid quality level specified.");
+                }
+                engine_chosen = true;
+            } else if (strcmp(name, "metric") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Metric not specified with metric switch.");
+                }
+                if ((metric = read_metric(argv[i])) == MT_NONE) {
+                    usage();
+                    error("Invalid metric specified.");
+                }
+            } else if (strcmp(name, "list-engines") == 0) {
+                for (size_t e = 0; e < df_num_engines; ++e) {
+                    printf("%-16s %s\n", df_engines[e].name, df_engines[e].description);
+                }
+                return 0;
+            } else if (strcmp(name, "bench") == 0) {
+                bench = true;
+            } else if (strcmp(name, "serve") == 0) {
+                serve = true;
+            } else if (strcmp(name, "serve-memory") == 0) {
+                if (++i >= argc || !(serve_memory = strtoull(argv[i], NULL, 10))) {
+                    usage();
+                    error("Invalid memory budget specified with serve-memory switch.");
+                }
+            } else if (strcmp(name, "serve-jobs") == 0) {
+                if (++i >= argc || !(serve_jobs = strtoull(argv[i], NULL, 10))) {
+                    usage();
+                    error("Invalid number of jobs specified with serve-jobs switch.");
+                }
+            } else if (strcmp(name, "trace") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No file specified with trace.");
+                }
+                trace_file = argv[i];
+            } else if (strcmp(name, "stats") == 0) {
+                stats = true;
+            } else if (strcmp(name, "metrics") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No file specified with metrics.");
+                }
+                metrics_file = argv[i];
+            } else if (strcmp(name, "metrics-interval") == 0) {
+                if (++i >= argc || !((metrics_interval = strtod(argv[i], NULL)) >= 0.0)) {
+                    usage();
+                    error("Invalid interval specified with metrics-interval switch.");
+                }
+            } else if (strcmp(name, "serve-cache") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No size specified with serve-cache.");
+                }
+                serve_cache = strtoull(argv[i], NULL, 10);
+            } else if (strcmp(name, "roofline") == 0) {
+                roofline = true;
+            } else if (strcmp(name, "sequence") == 0) {
+                sequence = true;
+            } else if (strcmp(name, "thresholds") == 0) {
+                if (++i >= argc ||
+                    !read_thresholds(argv[i], thresholds, sizeof(thresholds) / sizeof(thresholds[0]), &n_thresholds)) {
+                    usage();
+                    error("Invalid thresholds specified, expected up to 16 values between 0 and 255.");
+                }
+                threshold_stack = true;
+            } else if (strcmp(name, "gradient") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Layout not specified with gradient switch.");
+                }
+                if ((gradient = read_gradient(argv[i])) == GR_NONE) {
+                    usage();
+                    error("Invalid gradient layout specified.");
+                }
+            } else if (strcmp(name, "shard") == 0) {
+                if (++i >= argc || sscanf(argv[i], "%zu/%zu", &shard_index, &shard_count) != 2 || !shard_count ||
+                    shard_index >= shard_count) {
+                    usage();
+                    error("Invalid shard specified, expected i/N with i below N.");
+                }
+            } else if (strcmp(name, "tiled") == 0) {
+                if (++i >= argc || !(tile_rows = strtoull(argv[i], NULL, 10))) {
+                    usage();
+                    error("Invalid number of rows specified with tiled switch.");
+                }
+            } else if (strcmp(name, "resume") == 0) {
+                resume = true;
+            } else if (strcmp(name, "stream") == 0) {
+                stream = true;
+            } else if (strcmp(name, "progress") == 0) {
+                progress = true;
+            } else if (strcmp(name, "merge") == 0) {
+                merge = true;
+            } else if (strcmp(name, "border") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("Border not specified with border switch.");
+                }
+                if ((border = read_border(argv[i], &border_pad)) == BD_NONE) {
+                    usage();
+                    error("Invalid border specified.");
+                }
+            } else if (strcmp(name, "raw") == 0) {
+                if (++i >= argc || sscanf(argv[i], "%zux%zu", &raw_width, &raw_height) != 2 || !raw_width ||
+                    !raw_height) {
+                    usage();
+                    error("Invalid frame size specified with raw switch.");
+                }
+            } else if (strcmp(name, "effect") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No effect specified with effect switch.");
+                }
+                if (n_effects >= sizeof(effects) / sizeof(effects[0])) error("Too many effects specified.");
+                if (!effect_parse(argv[i], &effects[n_effects++])) {
+                    usage();
+                    error("Invalid effect \"%s\".", argv[i]);
+                }
+            } else if (strcmp(name, "vector") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No file specified with vector switch.");
+                }
+                vector_file = argv[i];
+            } else if (strcmp(name, "size") == 0) {
+                if (++i >= argc || sscanf(argv[i], "%zux%zu", &vector_width, &vector_height) != 2 || !vector_width ||
+                    !vector_height) {
+                    usage();
+                    error("Invalid output size specified with size switch.");
+                }
+            } else if (strcmp(name, "scale") == 0) {
+                if (++i >= argc || !((vector_scale = strtof(argv[i], NULL)) > 0.f)) {
+                    usage();
+                    error("Invalid scale specified with scale switch.");
+                }
+            } else if (strcmp(name, "first") == 0) {
+                if (++i >= argc) {
+                    usage();
+                    error("No number specified with first.");
+                }
+                first_frame = strtoull(argv[i], NULL, 10);
+            } else {
+                usage();
+                error("Unknown option \"%s\".", argv[i]);
+            }
         } break;
             // flags
         default: {
@@ -226,6 +531,18 @@ int main(int argc, char** argv) {
         }
     }
 
+    char opencl_exe[1024];
+    backend_opencl_exe(argv[0], opencl_exe, sizeof(opencl_exe));
+
+    if (calibrate) {
+        struct backend_calibration cal;
+        if (!backend_calibrate(argv[0], opencl_exe, device, &cal)) error("Calibration failed.");
+        printf("device: %s\n", cal.device);
+        printf("omp: %.3g s + %.3g s/px (%d threads)\n", cal.omp_setup, cal.omp_px, cal.omp_threads);
+        printf("opencl: %.3g s + %.3g s/px + %.3g s/(px*spread^2)\n", cal.ocl_setup, cal.ocl_px, cal.ocl_px_s2);
+        return 0;
+    }
+
     if (!quality || quality > 100) {
         usage();
         error("Invalid value given for jpeg quality. Must be between 1-100");
@@ -234,14 +551,212 @@ int main(int argc, char** argv) {
         usage();
         error("Invalid value given for spread. Must be a positive integer.");
     }
-    if (infile == NULL) {
+    if (metric != MT_NONE && engine->metric != metric) {
+        // a metric brings its own default engine, an engine chosen as well must compute that metric
+        if (engine_chosen) error("The engine does not compute the requested metric, see --list-engines.");
+        engine = df_metric_engine(metric);
+    }
+    if (serve || bench || roofline || (engine->metric != MT_L2 && backend == BE_AUTO)) backend = BE_OMP;
+    if (engine->metric != MT_L2 && backend != BE_OMP) error("Only the omp backend computes metrics other than l2.");
+    if (n_effects > 0 && backend != BE_OMP) error("Effects are only supported by the omp backend.");
+    if (gradient != GR_DISTANCE && (backend != BE_OMP || n_effects > 0)) {
+        error("Gradients are only supported by the omp backend, without effects.");
+    }
+    if (trace_file != NULL) {
+        if (!trace_start()) error("Trace buffers could not be allocated.");
+        atexit(write_trace);
+    }
+
+    // latency statistics of the modes running many jobs
+    struct metrics metrics;
+    bool collect_metrics = stats || metrics_file != NULL;
+    if (collect_metrics) metrics_init(&metrics, metrics_file, metrics_interval);
+
+    if (serve) {
+        // jobs name their own input and output, the other options apply to all of them
+        struct serve_config config = {
+            {engine, spread, asymmetric, effects, n_effects, gradient, border, border_pad, 0, 0, 0, 0, NULL},
+            serve_memory << 20,
+            serve_jobs,
+            serve_cache << 20,
+            collect_metrics ? &metrics : NULL,
+        };
+        bool ok = serve_run(stdin, stdout, &config);
+        if (stats) metrics_print(&metrics, stderr);
+        return ok ? 0 : -1;
+    }
+    if (infile == NULL && vector_file == NULL) {
         usage();
         error("No input file specified.");
     }
-    if (outfile == NULL) {
+    if (outfile == NULL && !bench && !roofline) {
         usage();
         error("No output file specified.");
     }
+    if (vector_file != NULL && (vector_width == 0 || sequence || bench || backend != BE_OMP)) {
+        usage();
+        error("Vector input needs --size and the omp backend, without --sequence or --bench.");
+    }
+    if (vector_file != NULL && engine->metric != MT_L2) error("Vector input only computes l2 distances.");
+
+    if (merge) {
+        filetype = output_to_stdout ? (filetype == FT_NONE ? FT_PNG : filetype) : deduce_filetype(outfile, filetype);
+        return shard_merge(infile, outfile, filetype, (int)quality) ? 0 : -1;
+    }
+    if (shard_count > 0 && (sequence || bench || threshold_stack || vector_file != NULL || backend != BE_OMP)) {
+        error("Shards are only supported by the omp backend for a single image.");
+    }
+    if (tile_rows > 0 && (sequence || bench || threshold_stack || vector_file != NULL || backend != BE_OMP ||
+                          shard_count > 0 || output_to_stdout || shm_output_requested(outfile))) {
+        error("Tiled runs are only supported by the omp backend for a single image written to a file.");
+    }
+
+    bool to_shm = outfile != NULL && shm_output_requested(outfile);
+    if (to_shm && (sequence || threshold_stack || vector_file != NULL || backend != BE_OMP)) {
+        error("Shared memory output is only supported by the omp backend for a single image.");
+    }
+    if (stream && (sequence || bench || roofline || threshold_stack || vector_file != NULL || backend != BE_OMP ||
+                   shard_count > 0 || tile_rows > 0 || to_shm)) {
+        error("Streaming is only supported by the omp backend for a single image.");
+    }
+    if (stream && !engine->exact) error("Streaming computes exact distances, it cannot use an approximate engine.");
+    if (stream && engine->metric != MT_L2) error("Streaming only computes l2 distances.");
+    if (stream && !image_stream_supported(output_to_stdout ? (filetype == FT_NONE ? FT_PNG : filetype)
+                                                           : deduce_filetype(outfile, filetype))) {
+        error("Streaming needs png, tga or bmp output.");
+    }
+    if (single_threshold && threshold_stack) {
+        usage();
+        error("-t and --thresholds cannot be combined.");
+    }
+    bool stack_to_files = threshold_stack && outfile != NULL && strchr(outfile, '%') != NULL;
+    if (threshold_stack && (sequence || bench || vector_file != NULL || backend != BE_OMP)) {
+        usage();
+        error("Thresholds need the omp backend, without --sequence, --bench or --vector.");
+    }
+    if (threshold_stack && !stack_to_files && (n_thresholds > 4 || n_effects > 0 || gradient != GR_DISTANCE)) {
+        usage();
+        error("More than 4 thresholds, or thresholds with effects or gradients, need an output pattern such as "
+              "out_%%d.png.");
+    }
+    if (stack_to_files && filename_pattern_numbers(outfile) != 1) {
+        error("Output patterns need exactly one threshold conversion such as out_%%d.png, and %%%% for a percent "
+              "sign.");
+    }
+
+    if (border != BD_CLIP && (backend != BE_OMP || vector_file != NULL)) {
+        error("Borders are only supported by the omp backend for image input.");
+    }
+
+    struct df_control control;
+    df_control_init(&control, print_progress, NULL);
+    struct sdf_params params = {engine, spread, asymmetric, effects, n_effects, gradient, border, border_pad,
+                                0,      0,      0,          0,         progress ? &control : NULL};
+
+    if (vector_file != NULL) {
+        bool vector_from_stdin = strcmp(vector_file, "-") == 0;
+        FILE* vector_stream = vector_from_stdin ? stdin : fopen(vector_file, "rb");
+        if (vector_stream == NULL) error("Vector file could not be opened.");
+        size_t text_size;
+        unsigned char* text = read_stream(vector_stream, &text_size);
+        if (!vector_from_stdin) fclose(vector_stream);
+        if (text == NULL) error("Vector file could not be read.");
+        // terminate, read_stream always leaves room past the data
+        text[text_size] = '\0';
+
+        struct vector_outline outline;
+        bool parsed = vector_parse((const char*)text, vector_scale, &outline);
+        free(text);
+        if (!parsed) error("Vector file could not be parsed.");
+
+        size_t channels = sdf_channels(&params);
+        float* field = malloc(vector_width * vector_height * sizeof(float));
+        unsigned char* img_byte = malloc(vector_width * vector_height * channels * sizeof(unsigned char));
+        if (field == NULL || img_byte == NULL) error("Vector output malloc failed.");
+
+        if (!vector_distance_field(&outline, vector_width, vector_height, (float)sdf_reach(&params), field)) {
+            error("Vector segment grid malloc failed.");
+        }
+        vector_free(&outline);
+        sdf_encode_field(field, vector_width, vector_height, &params, img_byte);
+        free(field);
+
+        filetype = output_to_stdout ? (filetype == FT_NONE ? FT_PNG : filetype) : deduce_filetype(outfile, filetype);
+        if (!write_image(outfile, filetype, (int)vector_width, (int)vector_height, (int)channels, img_byte,
+                         (int)quality)) {
+            error("Output file could not be written.");
+        }
+        free(img_byte);
+        return 0;
+    }
+
+    if (sequence) {
+        struct sequence_params seq_params = {params,    test_channel, thresholds[0], test_above, filetype, (int)quality,
+                                             raw_width, raw_height,   first_frame,   collect_metrics ? &metrics : NULL};
+        bool ok = run_sequence(infile, outfile, &seq_params);
+        if (stats) metrics_print(&metrics, stderr);
+        return ok ? 0 : -1;
+    }
+
+    // stdin can only be read once, keep it in case it gets handed to the opencl program
+    unsigned char* input_data = NULL;
+    size_t input_size = 0;
+    if (backend != BE_OMP && open_from_stdin) {
+        input_data = read_stream(stdin, &input_size);
+        if (input_data == NULL) error("Input could not be read from stdin.");
+    }
+
+    if (backend == BE_AUTO) {
+        int info_w;
+        int info_h;
+        int info_n;
+        int info_status = input_data != NULL
+                              ? stbi_info_from_memory(input_data, (int)input_size, &info_w, &info_h, &info_n)
+                              : stbi_info(infile, &info_w, &info_h, &info_n);
+
+        struct backend_calibration cal;
+        bool have_cal = backend_load_calibration(device, &cal);
+        backend = info_status ? backend_choose(have_cal ? &cal : NULL, (size_t)info_w, (size_t)info_h, spread) : BE_OMP;
+    }
+
+    if (backend == BE_OPENCL) {
+        char spread_str[32];
+        char quality_str[32];
+        char threshold_str[32];
+        snprintf(spread_str, sizeof(spread_str), "%zu", spread);
+        snprintf(quality_str, sizeof(quality_str), "%zu", quality);
+        snprintf(threshold_str, sizeof(threshold_str), "%d", (int)thresholds[0]);
+
+        const char* args[16];
+        size_t n_args = 0;
+        args[n_args++] = "-i";
+        args[n_args++] = infile;
+        args[n_args++] = "-o";
+        args[n_args++] = outfile;
+        args[n_args++] = "-s";
+        args[n_args++] = spread_str;
+        args[n_args++] = "-q";
+        args[n_args++] = quality_str;
+        args[n_args++] = "-t";
+        args[n_args++] = threshold_str;
+        if (filetype_arg != NULL) {
+            args[n_args++] = "-f";
+            args[n_args++] = filetype_arg;
+        }
+        if (asymmetric) args[n_args++] = "-a";
+        if (test_channel == 0) args[n_args++] = "-l";
+        if (!test_above) args[n_args++] = "-n";
+        if (device != NULL) {
+            args[n_args++] = "--device";
+            args[n_args++] = device;
+        }
+
+        int status = backend_run_opencl(opencl_exe, args, n_args, input_data, input_size);
+        free(input_data);
+        if (status == BACKEND_COMMAND_TOO_LONG) error("Arguments are too long to pass on to the OpenCL backend.");
+        if (status != 0) error("OpenCL backend failed (%s).", opencl_exe);
+        return 0;
+    }
 
     // 2 channels sufficient to get alpha data of image
     int w;
@@ -249,102 +764,140 @@ int main(int argc, char** argv) {
     int n;
     int c = 2;
     unsigned char* img_original;
-    if (open_from_stdin) {
+    TRACE_BEGIN(decode, "decode");
+    if (input_data != NULL) {
+        img_original = stbi_load_from_memory(input_data, (int)input_size, &w, &h, &n, c);
+        free(input_data);
+    } else if (open_from_stdin) {
         img_original = stbi_load_from_file(stdin, &w, &h, &n, c);
     } else {
         img_original = stbi_load(infile, &w, &h, &n, c);
     }
 
     if (img_original == NULL) error("Input file could not be opened.");
+    TRACE_END(decode);
+
+    if (roofline) {
+        if (!roofline_report(img_original, (size_t)w, (size_t)h, (size_t)c, test_channel, thresholds[0], test_above,
+                             &params, filetype == FT_NONE ? FT_PNG : filetype)) {
+            error("Roofline buffers could not be allocated.");
+        }
+        stbi_image_free(img_original);
+        return 0;
+    }
 
-    // transform image into bool image
-    bool* img_bool = malloc((size_t)(w * h) * sizeof(bool));
-    if (img_bool == NULL) error("img_bool malloc failed.");
+    if (shard_count > 0) {
+        // only the rows the shard depends on are tested
+        struct shard shard = shard_plan(shard_index, shard_count, (size_t)h, sdf_reach(&params));
+        size_t window_h = shard.window_y1 - shard.window_y0;
+        bool* window_mask = malloc((size_t)w * window_h * sizeof(bool));
+        if (window_mask == NULL) error("img_bool malloc failed.");
 
-    transform_img_to_bool(img_original, img_bool, (size_t)w, (size_t)h, (size_t)c * sizeof(unsigned char), test_channel,
-                          test_above);
+        sdf_mask_from_image(img_original + shard.window_y0 * (size_t)w * (size_t)c, window_mask, (size_t)w, window_h,
+                            (size_t)c * sizeof(unsigned char), test_channel, thresholds[0], test_above);
+        stbi_image_free(img_original);
+
+        if (!shard_generate(&shard, window_mask, (size_t)w, (size_t)h, &params, outfile)) {
+            error("Shard could not be generated or written.");
+        }
+        free(window_mask);
+        return 0;
+    }
+
+    // transform image into bool images, one per threshold
+    size_t n_px = (size_t)w * (size_t)h;
+    bool* masks[sizeof(thresholds) / sizeof(thresholds[0])];
+    for (size_t t = 0; t < n_thresholds; ++t) {
+        if ((masks[t] = malloc(n_px * sizeof(bool))) == NULL) error("img_bool malloc failed.");
+    }
+
+    TRACE_BEGIN(mask, "mask");
+    sdf_masks_from_image(img_original, masks, thresholds, n_thresholds, (size_t)w, (size_t)h,
+                         (size_t)c * sizeof(unsigned char), test_channel, test_above);
+    TRACE_END(mask);
 
     stbi_image_free(img_original);
 
-    // compute 2d sdf images
-    // inside -- pixel distance to INSIDE
-    // outside -- pixel distance to OUTSIDE
-    float* img_float_inside = malloc((size_t)(w * h) * sizeof(float));
-    if (img_float_inside == NULL) error("img_float_inside malloc failed.");
-    float* img_float_outside = malloc((size_t)(w * h) * sizeof(float));
-    if (img_float_outside == NULL) error("img_float_outside malloc failed.");
-
-#pragma omp parallel sections num_threads(2)
-    {
-#pragma omp section
-        {
-            transform_bool_to_float(img_bool, img_float_inside, (size_t)w, (size_t)h, true);
-            dist_transform_2d(img_float_inside, (size_t)w, (size_t)h);
+    if (tile_rows > 0) {
+        if (!shard_generate_tiled(masks[0], (size_t)w, (size_t)h, tile_rows, &params, outfile, resume)) {
+            error(resume ? "Tiled run failed." : "Tiled run failed, continue it with --resume.");
         }
-#pragma omp section
-        {
-            transform_bool_to_float(img_bool, img_float_outside, (size_t)w, (size_t)h, false);
-            dist_transform_2d(img_float_outside, (size_t)w, (size_t)h);
+        free(masks[0]);
+        return 0;
+    }
+
+    if (bench) {
+        if (!bench_engines(masks[0], (size_t)w, (size_t)h, 5)) error("Benchmark buffers could not be allocated.");
+        free(masks[0]);
+        return 0;
+    }
+
+    size_t channels = sdf_channels(&params);
+    if (stream) {
+        filetype = output_to_stdout ? (filetype == FT_NONE ? FT_PNG : filetype) : deduce_filetype(outfile, filetype);
+        struct image_stream image;
+        if (!image_stream_open(&image, outfile, filetype, w, h, (int)channels)) {
+            error("Output file could not be opened for streaming.");
         }
+        bool ok = sdf_generate_streamed(masks[0], (size_t)w, (size_t)h, &params, STREAM_BAND_ROWS, emit_band, &image);
+        if (!image_stream_close(&image) || !ok) error("Streamed output could not be generated or written.");
+        free(masks[0]);
+        return 0;
     }
 
-    free(img_bool);
+    size_t plane_size = n_px * channels;
+    // shared memory output is generated in place
+    struct shm_output shm;
+    unsigned char* img_byte = to_shm ? shm_output_open(outfile, (size_t)w, (size_t)h, channels, &shm)
+                                     : malloc(plane_size * n_thresholds * sizeof(unsigned char));
+    if (img_byte == NULL) error(to_shm ? "Shared memory output could not be created." : "img_byte malloc failed.");
 
-    // consolidate in the form of (outside - inside) to img_float_outside
-    transform_float_sub(img_float_outside, img_float_inside, (size_t)w, (size_t)h);
-    free(img_float_inside);
+    unsigned char* byte_outs[sizeof(thresholds) / sizeof(thresholds[0])];
+    for (size_t t = 0; t < n_thresholds; ++t) byte_outs[t] = img_byte + t * plane_size;
 
-    // transform distance values to pixel values
-    unsigned char* img_byte = malloc((size_t)(w * h) * sizeof(unsigned char));
-    if (img_byte == NULL) error("img_byte malloc failed.");
-    transform_float_to_byte(img_float_outside, img_byte, (size_t)w, (size_t)h, spread, asymmetric);
+    TRACE_BEGIN(generate, "generate");
+    if (!sdf_generate_stack((const bool* const*)masks, n_thresholds, (size_t)w, (size_t)h, &params, byte_outs)) {
+        error("Distance field buffers malloc failed.");
+    }
+    TRACE_END(generate);
 
-    free(img_float_outside);
+    for (size_t t = 0; t < n_thresholds; ++t) free(masks[t]);
 
-    // deduce filetype if not specified
-    if (!output_to_stdout) {
-        char* dot = strrchr(outfile, '.');
-        if (dot != NULL && filetype == FT_NONE) {
-            filetype = read_filetype(dot + 1);
-        }
+    if (to_shm) {
+        if (!shm_output_finish(&shm)) error("Shared memory output could not be handed over.");
+        return 0;
     }
 
     // output image
-    switch (filetype) {
-    case FT_BMP: {
-        // bmp
-        if (output_to_stdout) {
-            stbi_write_bmp_to_func(write_to_stdout, NULL, w, h, 1, img_byte);
-        } else {
-            stbi_write_bmp(outfile, w, h, 1, img_byte);
-        }
-    } break;
-    case FT_JPG: {
-        // jpg
-        if (output_to_stdout) {
-            stbi_write_jpg_to_func(write_to_stdout, NULL, w, h, 1, img_byte, (int)quality);
-        } else {
-            stbi_write_jpg(outfile, w, h, 1, img_byte, (int)quality);
+    TRACE_BEGIN(write, "write");
+    filetype = output_to_stdout ? (filetype == FT_NONE ? FT_PNG : filetype) : deduce_filetype(outfile, filetype);
+    if (stack_to_files) {
+        for (size_t t = 0; t < n_thresholds; ++t) {
+            char path[4096];
+            snprintf(path, sizeof(path), outfile, (int)thresholds[t]);
+            if (!write_image(path, filetype, w, h, (int)channels, byte_outs[t], (int)quality)) {
+                error("Output file \"%s\" could not be written.", path);
+            }
         }
-    } break;
-    case FT_TGA: {
-        // tga
-        if (output_to_stdout) {
-            stbi_write_tga_to_func(write_to_stdout, NULL, w, h, 1, img_byte);
-        } else {
-            stbi_write_tga(outfile, w, h, 1, img_byte);
+    } else if (threshold_stack) {
+        // fields become the channels of one image
+        unsigned char* img_stack = malloc(n_px * n_thresholds * sizeof(unsigned char));
+        if (img_stack == NULL) error("img_stack malloc failed.");
+
+        ptrdiff_t i;
+#pragma omp parallel for schedule(static)
+        for (i = 0; i < (ptrdiff_t)(n_px); ++i) {
+            for (size_t t = 0; t < n_thresholds; ++t) img_stack[(size_t)i * n_thresholds + t] = byte_outs[t][i];
         }
-    } break;
-    case FT_PNG:
-    case FT_NONE: {
-        // png
-        if (output_to_stdout) {
-            stbi_write_png_to_func(write_to_stdout, NULL, w, h, 1, img_byte, w * (int)sizeof(unsigned char));
-        } else {
-            stbi_write_png(outfile, w, h, 1, img_byte, w * (int)sizeof(unsigned char));
+
+        if (!write_image(outfile, filetype, w, h, (int)n_thresholds, img_stack, (int)quality)) {
+            error("Output file could not be written.");
         }
-    } break;
+        free(img_stack);
+    } else if (!write_image(outfile, filetype, w, h, (int)channels, img_byte, (int)quality)) {
+        error("Output file could not be written.");
     }
+    TRACE_END(write);
 
     free(img_byte);
 
@@ -0,0 +1,296 @@
+#include "sequence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "stb/stb_image.h"
+#include "trace.h"
+
+// rectangle [x0,x1) x [y0,y1)
+struct region {
+    size_t x0;
+    size_t y0;
+    size_t x1;
+    size_t y1;
+};
+
+// grows r by margin on every side, clamped to the image
+static struct region expand(struct region r, size_t margin, size_t w, size_t h) {
+    struct region e;
+    e.x0 = r.x0 > margin ? r.x0 - margin : 0;
+    e.y0 = r.y0 > margin ? r.y0 - margin : 0;
+    e.x1 = r.x1 + margin < w ? r.x1 + margin : w;
+    e.y1 = r.y1 + margin < h ? r.y1 + margin : h;
+    return e;
+}
+
+static size_t area(struct region r) { return (r.x1 - r.x0) * (r.y1 - r.y0); }
+
+// recomputes out_bytes inside the output region from the mask within the (larger) input region
+static bool regenerate(const bool* mask, size_t w, size_t h, struct region in_r, struct region out_r,
+                       const struct sdf_params* params, unsigned char* out_bytes) {
+    size_t channels = sdf_channels(params);
+    size_t rw = in_r.x1 - in_r.x0;
+    size_t rh = in_r.y1 - in_r.y0;
+    bool* window = malloc(rw * rh * sizeof(bool));
+    unsigned char* window_bytes = malloc(rw * rh * channels);
+    bool ok = window != NULL && window_bytes != NULL;
+
+    if (ok) {
+        for (size_t y = 0; y < rh; ++y) memcpy(window + y * rw, mask + (in_r.y0 + y) * w + in_r.x0, rw * sizeof(bool));
+        // the border lies at the image edges, not the window edges
+        struct sdf_params window_params = *params;
+        window_params.frame_x = in_r.x0;
+        window_params.frame_y = in_r.y0;
+        window_params.frame_width = w;
+        window_params.frame_height = h;
+        ok = sdf_generate(window, rw, rh, &window_params, window_bytes);
+    }
+    if (ok) {
+        for (size_t y = out_r.y0; y < out_r.y1; ++y) {
+            memcpy(out_bytes + (y * w + out_r.x0) * channels,
+                   window_bytes + ((y - in_r.y0) * rw + (out_r.x0 - in_r.x0)) * channels,
+                   (out_r.x1 - out_r.x0) * channels);
+        }
+    }
+
+    free(window_bytes);
+    free(window);
+    return ok;
+}
+
+// Updates out_bytes for the pixels that can differ between prev_mask and mask.
+// A changed pixel only affects outputs within sdf_reach of it, since distances beyond that saturate. Rows with
+// changes are grouped into bands whose affected regions overlap, and each band is recomputed from a window that
+// includes every site which can be nearest to a pixel of its affected region.
+static bool update_changed(const bool* prev_mask, const bool* mask, size_t w, size_t h,
+                           const struct sdf_params* params, unsigned char* out_bytes, size_t* row_lo, size_t* row_hi) {
+    ptrdiff_t y;
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < (ptrdiff_t)(h); ++y) {
+        const bool* a = prev_mask + (size_t)y * w;
+        const bool* b = mask + (size_t)y * w;
+        size_t lo = w;
+        size_t hi = 0;
+        for (size_t x = 0; x < w; ++x) {
+            if (a[x] != b[x]) {
+                lo = x < lo ? x : lo;
+                hi = x + 1;
+            }
+        }
+        row_lo[y] = lo;
+        row_hi[y] = hi;
+    }
+
+    size_t reach = sdf_reach(params);
+    struct region bands[64];
+    size_t n_bands = 0;
+    size_t work = 0;
+    bool full = false;
+
+    for (size_t row = 0; row < h && !full; ++row) {
+        if (row_lo[row] >= row_hi[row]) continue;
+        struct region changed = {row_lo[row], row, row_hi[row], row + 1};
+
+        // join the previous band if the affected regions touch
+        if (n_bands > 0 && row <= bands[n_bands - 1].y1 + 2 * reach) {
+            struct region* band = &bands[n_bands - 1];
+            band->x0 = changed.x0 < band->x0 ? changed.x0 : band->x0;
+            band->x1 = changed.x1 > band->x1 ? changed.x1 : band->x1;
+            band->y1 = changed.y1;
+        } else if (n_bands < sizeof(bands) / sizeof(bands[0])) {
+            bands[n_bands++] = changed;
+        } else {
+            full = true;
+        }
+    }
+    if (n_bands == 0) return true;
+
+    for (size_t band = 0; band < n_bands; ++band) {
+        work += area(expand(bands[band], 2 * reach, w, h));
+    }
+    if (full || work >= w * h) return sdf_generate(mask, w, h, params, out_bytes);
+
+    for (size_t band = 0; band < n_bands; ++band) {
+        struct region out_r = expand(bands[band], reach, w, h);
+        struct region in_r = expand(bands[band], 2 * reach, w, h);
+        if (!regenerate(mask, w, h, in_r, out_r, params, out_bytes)) return false;
+    }
+    return true;
+}
+
+// makes sure buffer holds at least size bytes
+static bool reserve(void** buffer, size_t* capacity, size_t size) {
+    if (size <= *capacity) return true;
+    void* grown = realloc(*buffer, size);
+    if (grown == NULL) return false;
+    *buffer = grown;
+    *capacity = size;
+    return true;
+}
+
+// loads the next frame into mask, returns false once there are no more frames
+static bool read_frame(const char* in, size_t frame, const struct sequence_params* params, unsigned char** raw,
+                       bool** mask, size_t* mask_capacity, size_t* w, size_t* h) {
+    if (params->raw_width > 0) {
+        size_t size = params->raw_width * params->raw_height;
+        if (*raw == NULL && (*raw = malloc(size)) == NULL) return false;
+        if (fread(*raw, 1, size, stdin) != size) return false;
+        if (!reserve((void**)mask, mask_capacity, size * sizeof(bool))) return false;
+        *w = params->raw_width;
+        *h = params->raw_height;
+        sdf_mask_from_image(*raw, *mask, *w, *h, 1, 0, params->threshold, params->test_above);
+        return true;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), in, (int)frame);
+
+    int iw;
+    int ih;
+    int n;
+    int c = 2;
+    unsigned char* img = stbi_load(path, &iw, &ih, &n, c);
+    if (img == NULL) return false;
+
+    *w = (size_t)iw;
+    *h = (size_t)ih;
+    bool ok = reserve((void**)mask, mask_capacity, *w * *h * sizeof(bool));
+    if (ok) {
+        sdf_mask_from_image(img, *mask, *w, *h, (size_t)c, params->test_channel, params->threshold, params->test_above);
+    }
+    stbi_image_free(img);
+    return ok;
+}
+
+bool run_sequence(const char* in, const char* out, const struct sequence_params* params) {
+    bool from_stdin = strcmp(in, "-") == 0;
+    bool to_stdout = strcmp(out, "-") == 0;
+    if (from_stdin != (params->raw_width > 0)) {
+        fputs("Sequences read raw frames from stdin (--raw WxH) or image files from a pattern.\n", stderr);
+        return false;
+    }
+    if ((!from_stdin && filename_pattern_numbers(in) != 1) || (!to_stdout && filename_pattern_numbers(out) != 1)) {
+        fputs("Sequence filenames need exactly one frame number conversion such as %04d.\n", stderr);
+        return false;
+    }
+
+    bool raw_out = from_stdin && to_stdout;
+    enum FILETYPE filetype = to_stdout ? (params->filetype == FT_NONE ? FT_PNG : params->filetype)
+                                       : deduce_filetype(out, params->filetype);
+
+    unsigned char* raw = NULL;
+    bool* mask = NULL;
+    bool* prev_mask = NULL;
+    size_t mask_capacity = 0;
+    size_t prev_mask_capacity = 0;
+    unsigned char* out_bytes = NULL;
+    size_t* row_lo = NULL;
+    size_t* row_hi = NULL;
+    struct byte_buffer encoded = {NULL, 0, 0, false};
+    size_t w = 0;
+    size_t h = 0;
+    size_t prev_w = 0;
+    size_t prev_h = 0;
+    bool ok = true;
+
+    struct metrics* metrics = params->metrics;
+    double t = omp_get_wtime();
+    size_t frame = params->first;
+    for (; read_frame(in, frame, params, &raw, &mask, &mask_capacity, &w, &h); ++frame) {
+        double t_frame = t;
+        metrics_lap(metrics, ST_DECODE, &t);
+        TRACE_BEGIN(span, "frame");
+        bool same_size = frame > params->first && w == prev_w && h == prev_h;
+        bool unchanged = same_size && memcmp(prev_mask, mask, w * h * sizeof(bool)) == 0;
+        size_t channels = sdf_channels(&params->sdf);
+
+        if (!unchanged) {
+            if (!same_size) {
+                free(out_bytes);
+                free(row_lo);
+                free(row_hi);
+                out_bytes = malloc(w * h * channels);
+                row_lo = malloc(h * sizeof(size_t));
+                row_hi = malloc(h * sizeof(size_t));
+                ok = out_bytes != NULL && row_lo != NULL && row_hi != NULL &&
+                     sdf_generate(mask, w, h, &params->sdf, out_bytes);
+            } else {
+                ok = update_changed(prev_mask, mask, w, h, &params->sdf, out_bytes, row_lo, row_hi);
+            }
+            if (!ok) {
+                fprintf(stderr, "Frame %zu could not be generated.\n", frame);
+                break;
+            }
+            metrics_lap(metrics, ST_COMPUTE, &t);
+
+            // re-encode only when the output changed, unchanged frames reuse the encoded bytes
+            if (!raw_out) {
+                encoded.size = 0;
+                ok = encode_image(byte_buffer_write, &encoded, filetype, (int)w, (int)h, (int)channels, out_bytes,
+                                  params->quality) &&
+                     !encoded.failed;
+                if (!ok) {
+                    fprintf(stderr, "Frame %zu could not be encoded.\n", frame);
+                    break;
+                }
+            }
+        }
+
+        const unsigned char* data = raw_out ? out_bytes : encoded.data;
+        size_t size = raw_out ? w * h * channels : encoded.size;
+        if (to_stdout) {
+            ok = fwrite(data, 1, size, stdout) == size;
+        } else {
+            char path[4096];
+            snprintf(path, sizeof(path), out, (int)frame);
+            FILE* file = fopen(path, "wb");
+            ok = file != NULL && fwrite(data, 1, size, file) == size;
+            if (file != NULL) ok = fclose(file) == 0 && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "Frame %zu could not be written.\n", frame);
+            break;
+        }
+        metrics_lap(metrics, ST_ENCODE, &t);
+        TRACE_END_INDEX(span, frame);
+        if (metrics != NULL) {
+            metrics_record(metrics, ST_TOTAL, t - t_frame);
+            metrics_job_done(metrics, true);
+            metrics_update(metrics, NULL, 0, false);
+        }
+
+        // the current mask becomes the reference of the next frame
+        bool* swap_mask = prev_mask;
+        prev_mask = mask;
+        mask = swap_mask;
+        size_t swap_capacity = prev_mask_capacity;
+        prev_mask_capacity = mask_capacity;
+        mask_capacity = swap_capacity;
+        prev_w = w;
+        prev_h = h;
+    }
+
+    // a frame that failed is counted, reading past the last one is not
+    if (metrics != NULL) {
+        if (!ok) metrics_job_done(metrics, false);
+        metrics_update(metrics, NULL, 0, true);
+    }
+    if (ok && frame == params->first) {
+        fputs("No frames could be read.\n", stderr);
+        ok = false;
+    }
+    if (to_stdout) fflush(stdout);
+
+    free(encoded.data);
+    free(row_hi);
+    free(row_lo);
+    free(out_bytes);
+    free(prev_mask);
+    free(mask);
+    free(raw);
+    return ok;
+}
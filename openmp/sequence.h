@@ -0,0 +1,37 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image.h"
+#include "metrics.h"
+#include "sdf.h"
+
+struct sequence_params {
+    struct sdf_params sdf;
+    // channel tested of grey-alpha input, ignored for raw frames
+    size_t test_channel;
+    // pixels above threshold are inside, below it if not test_above
+    unsigned char threshold;
+    bool test_above;
+    // output encoding, ignored when writing raw frames
+    enum FILETYPE filetype;
+    int quality;
+    // size of raw 8-bit single channel frames on stdin, 0 when reading image files
+    size_t raw_width;
+    size_t raw_height;
+    // number of the first frame of an input pattern
+    size_t first;
+    // latencies of the frames by stage, NULL to collect none
+    struct metrics* metrics;
+};
+
+// Generates a distance field for every frame of a sequence, recomputing only the regions around pixels whose mask
+// changed since the previous frame.
+// in -- printf pattern with one integer conversion (e.g. frame_%04d.png), or "-" for raw frames on stdin
+// out -- printf pattern for output files, or "-" to write frames to stdout back to back
+// Returns false on the first frame that could not be processed, after reporting it on stderr.
+bool run_sequence(const char* in, const char* out, const struct sequence_params* params);
+
+#endif
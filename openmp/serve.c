@@ -0,0 +1,541 @@
+#include "serve.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <omp.h>
+
+#include "cache.h"
+#include "image.h"
+#include "metrics.h"
+#include "trace.h"
+#include "stb/stb_image.h"
+
+#define SERVE_LINE_MAX 8192
+#define SERVE_ID_MAX 64
+#define SERVE_TOKENS_MAX 16
+#define SERVE_CLASSES (PR_BATCH + 1)
+
+// decoded grey-alpha input and mask held by a job next to sdf_footprint and the encoded result
+#define SERVE_INPUT_BYTES_PER_PX 3
+
+struct server;
+
+struct job {
+    char id[SERVE_ID_MAX];
+    enum PRIORITY priority;
+    // priority its transforms pause by, raised to that of the most urgent identical job waiting for its result
+    atomic_int urgency;
+    char* input;
+    char* output;
+    struct sdf_params params;
+    size_t test_channel;
+    unsigned char threshold;
+    bool test_above;
+    // predicted peak memory in bytes, given back once the result is found in the cache
+    size_t footprint;
+    // time the job was read, latencies include the wait for admission
+    double received;
+    struct df_control control;
+    struct server* server;
+    // next job of a waiting queue or of the running list
+    struct job* next;
+};
+
+struct server {
+    mtx_t lock;
+    // broadcast whenever a job finishes or is cancelled
+    cnd_t changed;
+    FILE* out;
+    const struct serve_config* config;
+    // first in first out within each class
+    struct job* waiting[SERVE_CLASSES];
+    struct job* running;
+    // running jobs per class, read without the lock by the pause checks of running transforms
+    atomic_size_t n_running[SERVE_CLASSES];
+    size_t memory_used;
+    struct result_cache cache;
+};
+
+enum PRIORITY read_priority(const char* string) {
+    const char* priority_table[] = {"interactive", "normal", "batch"};
+    for (size_t priority = 0; priority < SERVE_CLASSES; ++priority) {
+        if (strcmp(string, priority_table[priority]) == 0) return (enum PRIORITY)priority;
+    }
+    return PR_NONE;
+}
+
+static char* copy_string(const char* str) {
+    size_t size = strlen(str) + 1;
+    char* copy = malloc(size);
+    if (copy != NULL) memcpy(copy, str, size);
+    return copy;
+}
+
+static void free_job(struct job* job) {
+    free(job->output);
+    free(job->input);
+    free(job);
+}
+
+// answers a job, the lock must be held
+static void respond(struct server* server, const char* id, const char* reason, double ms) {
+    if (reason == NULL) {
+        fprintf(server->out, "%s ok %.1f\n", id, ms);
+    } else {
+        fprintf(server->out, "%s error %s\n", id, reason);
+    }
+    fflush(server->out);
+}
+
+static void record(struct server* server, enum STAGE stage, double seconds) {
+    if (server->config->metrics != NULL) metrics_record(server->config->metrics, stage, seconds);
+}
+
+// rewrites the metrics file when it is due, or right away if force, the lock must be held
+static void update_metrics(struct server* server, bool force) {
+    if (server->config->metrics == NULL) return;
+    struct metrics_counter counters[] = {
+        {"cache_hits_total", "Jobs served from the result cache.", server->cache.hits},
+        {"cache_misses_total", "Jobs whose result was computed.", server->cache.misses},
+        {"cache_coalesced_total", "Jobs that waited for the result of an identical running job.",
+         server->cache.coalesced},
+    };
+    metrics_update(server->config->metrics, counters, sizeof(counters) / sizeof(counters[0]), force);
+}
+
+// answers a job and counts its result, the lock must be held
+static void finish(struct server* server, const char* id, const char* reason, double ms) {
+    respond(server, id, reason, ms);
+    if (server->config->metrics != NULL) metrics_job_done(server->config->metrics, reason == NULL);
+    update_metrics(server, false);
+}
+
+static bool more_urgent_running(struct server* server, int priority) {
+    for (int p = 0; p < priority; ++p) {
+        if (atomic_load_explicit(&server->n_running[p], memory_order_relaxed) > 0) return true;
+    }
+    return false;
+}
+
+// pause hook of a job's transforms, holds the calling thread while a more urgent job runs
+static void pause_job(void* context) {
+    struct job* job = context;
+    struct server* server = job->server;
+    if (!more_urgent_running(server, atomic_load(&job->urgency))) return;
+
+    mtx_lock(&server->lock);
+    while (more_urgent_running(server, atomic_load(&job->urgency)) && !atomic_load(&job->control.cancel)) {
+        cnd_wait(&server->changed, &server->lock);
+    }
+    mtx_unlock(&server->lock);
+}
+
+static void admit(struct server* server);
+
+// reads a whole file into a malloc'd buffer, returns NULL if it could not be read
+static unsigned char* read_file(const char* filename, size_t* size_out) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return NULL;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    unsigned char* data = size >= 0 && fseek(file, 0, SEEK_SET) == 0 ? malloc((size_t)size + 1) : NULL;
+    if (data != NULL && fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size_out = (size_t)size;
+    return data;
+}
+
+static bool write_file(const char* filename, const unsigned char* data, size_t size) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+// cache key material of a job, the options it can set (the others are the same for all jobs) followed by its input
+// file's content, returned malloc'd with its size and hash, NULL if out of memory
+static unsigned char* job_key(const struct job* job, enum FILETYPE filetype, const unsigned char* input,
+                              size_t input_size, size_t* size_out, uint64_t* key_out) {
+    unsigned char options[] = {job->params.asymmetric, job->test_above, job->threshold,
+                               (unsigned char)job->test_channel, (unsigned char)filetype};
+    size_t spread = job->params.spread;
+    size_t size = sizeof(options) + sizeof(spread) + input_size;
+    unsigned char* material = malloc(size);
+    if (material == NULL) return NULL;
+    memcpy(material, options, sizeof(options));
+    memcpy(material + sizeof(options), &spread, sizeof(spread));
+    memcpy(material + sizeof(options) + sizeof(spread), input, input_size);
+
+    *size_out = size;
+    *key_out = cache_hash(CACHE_HASH_SEED, material, size);
+    return material;
+}
+
+// Gives the memory reserved for computing a job to the waiting jobs once it is served without computing. Only a ready
+// result may do that: a job waiting for a pending one keeps its share, as it takes over if that computation fails.
+// The lock must be held.
+static void release_footprint(struct server* server, struct job* job) {
+    server->memory_used -= job->footprint;
+    job->footprint = 0;
+    admit(server);
+}
+
+// Finds the result of key for job, waiting while an identical job computes it. Returns it filled, reserved for job
+// to compute if there is none, owning material then, or NULL with the reason, held by job in the first two cases.
+// The lock must be held.
+static struct cache_entry* find_result(struct server* server, struct job* job, uint64_t key, unsigned char* material,
+                                       size_t material_size, const char** reason_out) {
+    struct result_cache* cache = &server->cache;
+    struct cache_entry* entry;
+    while ((entry = cache_acquire(cache, key, material, material_size)) != NULL) {
+        if (entry->ready) {
+            ++cache->hits;
+            release_footprint(server, job);
+            return entry;
+        }
+
+        // the job computing it now pauses only for jobs more urgent than the most urgent one waiting for it
+        struct job* owner = entry->owner;
+        if ((int)job->priority < atomic_load(&owner->urgency)) atomic_store(&owner->urgency, (int)job->priority);
+        cnd_broadcast(&server->changed);
+        double t_wait = omp_get_wtime();
+        while (!entry->ready && !entry->abandoned && !atomic_load(&job->control.cancel)) {
+            cnd_wait(&server->changed, &server->lock);
+        }
+        if (entry->ready) {
+            // the wait stands in for computing it
+            record(server, ST_COMPUTE, omp_get_wtime() - t_wait);
+            ++cache->coalesced;
+            release_footprint(server, job);
+            return entry;
+        }
+
+        // the computation failed, one of the jobs waiting for it takes over
+        cache_release(cache, entry);
+        if (atomic_load(&job->control.cancel)) {
+            *reason_out = "cancelled";
+            return NULL;
+        }
+    }
+
+    ++cache->misses;
+    entry = cache_reserve(cache, key, material, material_size, job);
+    if (entry == NULL) *reason_out = "out of memory";
+    return entry;
+}
+
+// computes the encoded result of a job into encoded, returns NULL or the reason it failed
+// t -- start of the decode stage, moved on to the start of the encode stage
+static const char* compute(struct job* job, enum FILETYPE filetype, const unsigned char* input, size_t input_size,
+                           struct byte_buffer* encoded, double* t) {
+    int w;
+    int h;
+    int n;
+    int c = 2;
+    unsigned char* img = stbi_load_from_memory(input, (int)input_size, &w, &h, &n, c);
+    if (img == NULL) return "input could not be read";
+    metrics_lap(job->server->config->metrics, ST_DECODE, t);
+
+    size_t n_px = (size_t)w * (size_t)h;
+    size_t channels = sdf_channels(&job->params);
+    bool* mask = malloc(n_px * sizeof(bool));
+    unsigned char* out = malloc(n_px * channels);
+    const char* reason = mask == NULL || out == NULL ? "out of memory" : NULL;
+
+    if (reason == NULL) {
+        sdf_mask_from_image(img, mask, (size_t)w, (size_t)h, (size_t)c, job->test_channel, job->threshold,
+                            job->test_above);
+        stbi_image_free(img);
+        img = NULL;
+
+        if (!sdf_generate(mask, (size_t)w, (size_t)h, &job->params, out)) {
+            reason = atomic_load(&job->control.cancel) ? "cancelled" : "out of memory";
+        } else {
+            metrics_lap(job->server->config->metrics, ST_COMPUTE, t);
+            if (!encode_image(byte_buffer_write, encoded, filetype, w, h, (int)channels, out, 100) || encoded->failed) {
+                reason = "output could not be encoded";
+            }
+        }
+    }
+
+    free(out);
+    free(mask);
+    stbi_image_free(img);
+    return reason;
+}
+
+// runs a job through to its output file, from the cache when an identical job ran before, returns NULL or the reason
+// it failed
+static const char* generate(struct job* job) {
+    struct server* server = job->server;
+    double t = omp_get_wtime();
+    size_t input_size;
+    unsigned char* input = read_file(job->input, &input_size);
+    if (input == NULL) return "input could not be read";
+    enum FILETYPE filetype = deduce_filetype(job->output, FT_NONE);
+    size_t material_size;
+    uint64_t key;
+    unsigned char* material = job_key(job, filetype, input, input_size, &material_size, &key);
+    if (material == NULL) {
+        free(input);
+        return "out of memory";
+    }
+    double t_read = omp_get_wtime();
+
+    const char* reason = NULL;
+    mtx_lock(&server->lock);
+    struct cache_entry* entry = find_result(server, job, key, material, material_size, &reason);
+    bool compute_result = entry != NULL && !entry->ready;
+    mtx_unlock(&server->lock);
+    // a reserved entry keeps the material of its key
+    if (!compute_result) free(material);
+
+    if (compute_result) {
+        struct byte_buffer encoded = {NULL, 0, 0, false};
+        reason = compute(job, filetype, input, input_size, &encoded, &t);
+        mtx_lock(&server->lock);
+        if (reason == NULL) {
+            cache_fill(&server->cache, entry, encoded.data, encoded.size);
+        } else {
+            cache_abandon(&server->cache, entry);
+            free(encoded.data);
+        }
+        cnd_broadcast(&server->changed);
+        mtx_unlock(&server->lock);
+    } else if (entry != NULL) {
+        // served from the cache, reading and hashing the input was all its decoding
+        record(server, ST_DECODE, t_read - t);
+        t = omp_get_wtime();
+    }
+    free(input);
+
+    // a filled entry is not changed again and stays while held, so it is written without the lock
+    if (reason == NULL && !write_file(job->output, entry->data, entry->size)) reason = "output could not be written";
+    if (reason == NULL) metrics_lap(server->config->metrics, ST_ENCODE, &t);
+    if (entry != NULL) {
+        mtx_lock(&server->lock);
+        cache_release(&server->cache, entry);
+        mtx_unlock(&server->lock);
+    }
+    return reason;
+}
+
+static int run_job(void* arg) {
+    struct job* job = arg;
+    struct server* server = job->server;
+    record(server, ST_QUEUE, omp_get_wtime() - job->received);
+    TRACE_BEGIN(span, "job");
+    const char* reason = generate(job);
+    TRACE_END(span);
+    double total = omp_get_wtime() - job->received;
+    record(server, ST_TOTAL, total);
+    double ms = total * 1000.0;
+
+    mtx_lock(&server->lock);
+    finish(server, job->id, reason, ms);
+    for (struct job** link = &server->running; *link != NULL; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            break;
+        }
+    }
+    server->memory_used -= job->footprint;
+    atomic_fetch_sub(&server->n_running[job->priority], 1);
+    admit(server);
+    cnd_broadcast(&server->changed);
+    mtx_unlock(&server->lock);
+
+    free_job(job);
+    return 0;
+}
+
+// starts waiting jobs in priority order while their class has a free slot and they fit, the lock must be held
+static void admit(struct server* server) {
+    const struct serve_config* config = server->config;
+    for (int p = 0; p < SERVE_CLASSES; ++p) {
+        struct job* job;
+        while ((job = server->waiting[p]) != NULL && atomic_load(&server->n_running[p]) < config->jobs_per_class) {
+            // a class waiting for memory holds back the less urgent ones, which would only take more of it
+            if (server->memory_used + job->footprint > config->memory_budget) return;
+
+            server->waiting[p] = job->next;
+            server->memory_used += job->footprint;
+            atomic_fetch_add(&server->n_running[p], 1);
+            job->next = server->running;
+            server->running = job;
+
+            thrd_t thread;
+            if (thrd_create(&thread, run_job, job) != thrd_success) {
+                server->running = job->next;
+                server->memory_used -= job->footprint;
+                atomic_fetch_sub(&server->n_running[p], 1);
+                finish(server, job->id, "could not be started", 0.0);
+                free_job(job);
+                continue;
+            }
+            thrd_detach(thread);
+        }
+    }
+}
+
+// parses a job line into job_out, returns NULL or the reason it was rejected
+static const char* parse_job(struct server* server, char** tokens, size_t n_tokens, struct job** job_out) {
+    if (n_tokens < 4) return "expected <id> <priority> <input> <output> [options]";
+    if (strlen(tokens[0]) >= SERVE_ID_MAX) return "id too long";
+
+    struct job* job = calloc(1, sizeof(struct job));
+    if (job == NULL) return "out of memory";
+    memcpy(job->id, tokens[0], strlen(tokens[0]) + 1);
+    job->input = copy_string(tokens[2]);
+    job->output = copy_string(tokens[3]);
+    job->params = server->config->params;
+    job->test_channel = 1;
+    job->threshold = 127;
+    job->test_above = true;
+    job->server = server;
+    job->received = omp_get_wtime();
+
+    const char* reason = job->input == NULL || job->output == NULL ? "out of memory" : NULL;
+    if (reason == NULL && (job->priority = read_priority(tokens[1])) == PR_NONE) reason = "unknown priority";
+    for (size_t i = 4; reason == NULL && i < n_tokens; ++i) {
+        if (strcmp(tokens[i], "-s") == 0 && i + 1 < n_tokens) {
+            job->params.spread = strtoull(tokens[++i], NULL, 10);
+            if (job->params.spread == 0) reason = "invalid spread";
+        } else if (strcmp(tokens[i], "-t") == 0 && i + 1 < n_tokens) {
+            unsigned long threshold = strtoul(tokens[++i], NULL, 10);
+            if (threshold > 255) reason = "invalid threshold";
+            job->threshold = (unsigned char)threshold;
+        } else if (strcmp(tokens[i], "-a") == 0) {
+            job->params.asymmetric = true;
+        } else if (strcmp(tokens[i], "-n") == 0) {
+            job->test_above = false;
+        } else if (strcmp(tokens[i], "-l") == 0) {
+            job->test_channel = 0;
+        } else {
+            reason = "unknown option";
+        }
+    }
+
+    // admission is decided before decoding, from the size in the header
+    int w;
+    int h;
+    int n;
+    long input_size = -1;
+    FILE* file = reason == NULL ? fopen(job->input, "rb") : NULL;
+    if (file != NULL) {
+        if (stbi_info_from_file(file, &w, &h, &n) && fseek(file, 0, SEEK_END) == 0) input_size = ftell(file);
+        fclose(file);
+    }
+    if (reason == NULL && input_size < 0) reason = "input could not be read";
+    if (reason == NULL) {
+        size_t n_px = (size_t)w * (size_t)h;
+        job->footprint = (size_t)input_size + n_px * (SERVE_INPUT_BYTES_PER_PX + sdf_channels(&job->params)) +
+                         sdf_footprint((size_t)w, (size_t)h, &job->params);
+        if (job->footprint > server->config->memory_budget) reason = "exceeds the memory budget";
+    }
+
+    if (reason != NULL) {
+        free_job(job);
+        return reason;
+    }
+    atomic_init(&job->urgency, (int)job->priority);
+    df_control_init(&job->control, NULL, job);
+    job->control.pause = pause_job;
+    job->params.control = &job->control;
+    *job_out = job;
+    return NULL;
+}
+
+// cancels a waiting or running job, the lock must be held
+static void cancel_job(struct server* server, const char* id) {
+    for (int p = 0; p < SERVE_CLASSES; ++p) {
+        for (struct job** link = &server->waiting[p]; *link != NULL; link = &(*link)->next) {
+            struct job* job = *link;
+            if (strcmp(job->id, id) != 0) continue;
+            *link = job->next;
+            finish(server, job->id, "cancelled", 0.0);
+            free_job(job);
+            return;
+        }
+    }
+    for (struct job* job = server->running; job != NULL; job = job->next) {
+        if (strcmp(job->id, id) != 0) continue;
+        // the job answers once its transforms return, paused ones are woken to notice
+        atomic_store(&job->control.cancel, true);
+        cnd_broadcast(&server->changed);
+        return;
+    }
+    respond(server, id, "unknown job", 0.0);
+}
+
+static bool server_busy(const struct server* server) {
+    for (int p = 0; p < SERVE_CLASSES; ++p) {
+        if (server->waiting[p] != NULL) return true;
+    }
+    return server->running != NULL;
+}
+
+bool serve_run(FILE* in, FILE* out, const struct serve_config* config) {
+    struct server server;
+    memset(&server, 0, sizeof(server));
+    server.out = out;
+    server.config = config;
+    for (int p = 0; p < SERVE_CLASSES; ++p) atomic_init(&server.n_running[p], 0);
+    if (config->jobs_per_class == 0 || !cache_init(&server.cache, config->cache_capacity)) return false;
+    if (mtx_init(&server.lock, mtx_plain) != thrd_success) {
+        cache_free(&server.cache);
+        return false;
+    }
+    if (cnd_init(&server.changed) != thrd_success) {
+        mtx_destroy(&server.lock);
+        cache_free(&server.cache);
+        return false;
+    }
+
+    char line[SERVE_LINE_MAX];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char* tokens[SERVE_TOKENS_MAX];
+        size_t n_tokens = 0;
+        for (char* token = strtok(line, " \t\r\n"); token != NULL && n_tokens < SERVE_TOKENS_MAX;
+             token = strtok(NULL, " \t\r\n")) {
+            tokens[n_tokens++] = token;
+        }
+        if (n_tokens == 0) continue;
+
+        if (strcmp(tokens[0], "cancel") == 0 && n_tokens == 2) {
+            mtx_lock(&server.lock);
+            cancel_job(&server, tokens[1]);
+            mtx_unlock(&server.lock);
+            continue;
+        }
+
+        struct job* job = NULL;
+        const char* reason = parse_job(&server, tokens, n_tokens, &job);
+        mtx_lock(&server.lock);
+        if (reason != NULL) {
+            finish(&server, tokens[0], reason, 0.0);
+        } else {
+            struct job** tail = &server.waiting[job->priority];
+            while (*tail != NULL) tail = &(*tail)->next;
+            *tail = job;
+            admit(&server);
+        }
+        mtx_unlock(&server.lock);
+    }
+
+    // input ended, finish everything already accepted
+    mtx_lock(&server.lock);
+    while (server_busy(&server)) cnd_wait(&server.changed, &server.lock);
+    update_metrics(&server, true);
+    mtx_unlock(&server.lock);
+
+    cnd_destroy(&server.changed);
+    mtx_destroy(&server.lock);
+    cache_free(&server.cache);
+    return true;
+}
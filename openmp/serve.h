@@ -0,0 +1,41 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "metrics.h"
+#include "sdf.h"
+
+// Classes of service jobs, most urgent first
+enum PRIORITY { PR_NONE = -1, PR_INTERACTIVE, PR_NORMAL, PR_BATCH };
+
+struct serve_config {
+    // engine, effects and the other generation options shared by all jobs, which set spread and the mask test
+    struct sdf_params params;
+    // bytes all admitted jobs may hold together, by their predicted footprint
+    size_t memory_budget;
+    // jobs of each class running at once
+    size_t jobs_per_class;
+    // bytes of encoded results kept for repeated jobs
+    size_t cache_capacity;
+    // latencies of all jobs by stage, with the cache counters written to its file, NULL to collect none
+    struct metrics* metrics;
+};
+
+// reads interactive, normal or batch
+enum PRIORITY read_priority(const char* string);
+
+// Runs a resident service reading jobs from in, one per line, until it ends and all jobs are done.
+//   <id> <priority> <input> <output> [-s spread] [-t threshold] [-a] [-n] [-l]
+//   cancel <id>
+// Each job is answered on out with "<id> ok <milliseconds>" or "<id> error <reason>", in order of completion.
+// Jobs are admitted in priority order while their footprint fits the memory budget, and running jobs pause at the next
+// block of rows while a job of a more urgent class runs.
+// Results are kept in a least recently used cache keyed by a hash of the input file's content and the job's options.
+// A job identical to one still running waits for its result instead of computing it again.
+// Returns false if the service could not be started.
+bool serve_run(FILE* in, FILE* out, const struct serve_config* config);
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "shard.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sites farther than reach cannot change an output, distances saturate before them
+static void set_window(struct shard* shard, size_t height, size_t reach) {
+    shard->window_y0 = shard->y0 > reach ? shard->y0 - reach : 0;
+    shard->window_y1 = shard->y1 + reach < height ? shard->y1 + reach : height;
+}
+
+struct shard shard_plan(size_t index, size_t count, size_t height, size_t reach) {
+    struct shard shard;
+    shard.index = index;
+    shard.count = count;
+    shard.y0 = height * index / count;
+    shard.y1 = height * (index + 1) / count;
+    set_window(&shard, height, reach);
+    return shard;
+}
+
+// generates the rows of shard into rows_out from the mask rows of its window
+static bool generate_rows(const struct shard* shard, const bool* window_mask, size_t width, size_t height,
+                          const struct sdf_params* params, unsigned char* rows_out) {
+    size_t row_size = width * sdf_channels(params);
+    size_t window_h = shard->window_y1 - shard->window_y0;
+    unsigned char* window_bytes = malloc(window_h * row_size);
+    if (window_bytes == NULL) return false;
+
+    // the border lies at the image edges, not the window edges
+    struct sdf_params window_params = *params;
+    window_params.frame_x = 0;
+    window_params.frame_y = shard->window_y0;
+    window_params.frame_width = width;
+    window_params.frame_height = height;
+    bool ok = sdf_generate(window_mask, width, window_h, &window_params, window_bytes);
+    if (ok) {
+        memcpy(rows_out, window_bytes + (shard->y0 - shard->window_y0) * row_size, (shard->y1 - shard->y0) * row_size);
+    }
+
+    free(window_bytes);
+    return ok;
+}
+
+bool shard_generate(const struct shard* shard, const bool* window_mask, size_t width, size_t height,
+                    const struct sdf_params* params, const char* filename) {
+    size_t channels = sdf_channels(params);
+    size_t row_size = width * channels;
+    size_t n_rows = shard->y1 - shard->y0;
+    unsigned char* rows = malloc(n_rows * row_size);
+    if (rows == NULL) return false;
+    bool ok = generate_rows(shard, window_mask, width, height, params, rows);
+
+    bool to_stdout = strcmp(filename, "-") == 0;
+    FILE* file = NULL;
+    if (ok) {
+        file = to_stdout ? stdout : fopen(filename, "wb");
+        ok = file != NULL;
+    }
+    if (ok) {
+        struct shard_header header = {SHARD_MAGIC,          (uint32_t)width,       (uint32_t)height,
+                                      (uint32_t)channels,   (uint32_t)shard->index, (uint32_t)shard->count,
+                                      (uint32_t)shard->y0, (uint32_t)shard->y1};
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(rows, row_size, n_rows, file) == n_rows;
+        ok = (to_stdout ? fflush(file) : fclose(file)) == 0 && ok;
+    }
+
+    free(rows);
+    return ok;
+}
+
+// FNV-1a, cheap enough to verify every finished band on resume
+static uint64_t checksum_update(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t checksum(const unsigned char* data, size_t size) {
+    return checksum_update(0xcbf29ce484222325ull, data, size);
+}
+
+static uint64_t checksum_value(uint64_t hash, uint64_t value) { return checksum_update(hash, &value, sizeof(value)); }
+
+// identifies the job a tiled file belongs to: the mask, which follows from the input bytes, threshold and test
+// channel, and every parameter that changes the output
+static uint64_t job_checksum(const bool* mask, size_t width, size_t height, const struct sdf_params* params) {
+    uint64_t hash = checksum((const unsigned char*)mask, width * height * sizeof(bool));
+    hash = checksum_update(hash, params->engine->name, strlen(params->engine->name));
+    hash = checksum_value(hash, (uint64_t)params->engine->metric);
+    hash = checksum_value(hash, params->spread);
+    hash = checksum_value(hash, params->asymmetric);
+    hash = checksum_value(hash, (uint64_t)params->gradient);
+    hash = checksum_value(hash, (uint64_t)params->border);
+    hash = checksum_value(hash, params->border_pad);
+    hash = checksum_value(hash, params->frame_x);
+    hash = checksum_value(hash, params->frame_y);
+    hash = checksum_value(hash, params->frame_width);
+    hash = checksum_value(hash, params->frame_height);
+    hash = checksum_value(hash, params->n_effects);
+    for (size_t i = 0; i < params->n_effects; ++i) {
+        const struct effect* effect = &params->effects[i];
+        // field by field, padding bytes are not part of an effect
+        hash = checksum_update(hash, &effect->d0, sizeof(effect->d0));
+        hash = checksum_update(hash, &effect->d1, sizeof(effect->d1));
+        hash = checksum_update(hash, effect->c0, sizeof(effect->c0));
+        hash = checksum_update(hash, effect->c1, sizeof(effect->c1));
+        hash = checksum_value(hash, effect->absolute);
+        hash = checksum_value(hash, (uint64_t)effect->dx);
+        hash = checksum_value(hash, (uint64_t)effect->dy);
+    }
+    return hash;
+}
+
+// seeks to a byte offset from the start of file, past 2 GiB where long is 32 bits
+static bool seek_to(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// marks bands recorded in the journal whose data in file still matches, returns false if the journal is of another job
+static bool read_journal(FILE* journal, FILE* file, const struct shard_header* header, size_t band_rows, uint64_t job,
+                         bool* done, unsigned char* band_bytes) {
+    unsigned w, h, channels, rows;
+    unsigned long long journal_job;
+    if (fscanf(journal, "chaq_sdfgen journal %u %u %u %u %llx", &w, &h, &channels, &rows, &journal_job) != 5 ||
+        w != header->width || h != header->height || channels != header->channels || rows != band_rows ||
+        (uint64_t)journal_job != job) {
+        return false;
+    }
+
+    size_t row_size = (size_t)header->width * header->channels;
+    size_t n_bands = (header->height + band_rows - 1) / band_rows;
+    size_t band;
+    unsigned long long sum;
+    // a line cut short by preemption simply ends the journal
+    while (fscanf(journal, " band %zu %llx", &band, &sum) == 2) {
+        if (band >= n_bands) continue;
+        size_t y0 = band * band_rows;
+        size_t n_rows = y0 + band_rows < header->height ? band_rows : header->height - y0;
+        bool intact = seek_to(file, sizeof(*header) + (uint64_t)y0 * row_size) &&
+                      fread(band_bytes, row_size, n_rows, file) == n_rows &&
+                      checksum(band_bytes, n_rows * row_size) == (uint64_t)sum;
+        done[band] = intact;
+    }
+    return true;
+}
+
+bool shard_generate_tiled(const bool* mask, size_t width, size_t height, size_t band_rows,
+                          const struct sdf_params* params, const char* filename, bool resume) {
+    size_t channels = sdf_channels(params);
+    size_t row_size = width * channels;
+    size_t n_bands = (height + band_rows - 1) / band_rows;
+    struct shard_header header = {SHARD_MAGIC,        (uint32_t)width, (uint32_t)height, (uint32_t)channels, 0, 1, 0,
+                                  (uint32_t)height};
+
+    char journal_path[4096];
+    snprintf(journal_path, sizeof(journal_path), "%s.journal", filename);
+
+    bool* done = calloc(n_bands, sizeof(bool));
+    unsigned char* band_bytes = malloc(band_rows * row_size);
+    if (done == NULL || band_bytes == NULL) {
+        free(band_bytes);
+        free(done);
+        return false;
+    }
+
+    // keep the output and journal of an interrupted run of the same job
+    FILE* file = resume ? fopen(filename, "r+b") : NULL;
+    FILE* journal = resume ? fopen(journal_path, "r") : NULL;
+    struct shard_header existing;
+    uint64_t job = job_checksum(mask, width, height, params);
+    bool resuming = file != NULL && journal != NULL && fread(&existing, sizeof(existing), 1, file) == 1 &&
+                    memcmp(&existing, &header, sizeof(header)) == 0 &&
+                    read_journal(journal, file, &header, band_rows, job, done, band_bytes);
+    // bands of another input or other parameters would end up in this job's output
+    bool foreign = file != NULL && journal != NULL && !resuming;
+    if (journal != NULL) fclose(journal);
+    if (foreign) {
+        fprintf(stderr, "\"%s\" records another job, remove it to start over.\n", journal_path);
+        fclose(file);
+        free(band_bytes);
+        free(done);
+        return false;
+    }
+
+    if (resuming) {
+        journal = fopen(journal_path, "a");
+    } else {
+        // preallocate the whole file, every band is written in place
+        memset(done, 0, n_bands * sizeof(bool));
+        if (file != NULL) fclose(file);
+        file = fopen(filename, "w+b");
+        bool allocated = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                         seek_to(file, sizeof(header) + (uint64_t)height * row_size - 1) &&
+                         fputc(0, file) == 0;
+        journal = allocated ? fopen(journal_path, "w") : NULL;
+        if (journal != NULL) {
+            fprintf(journal, "chaq_sdfgen journal %zu %zu %zu %zu %016llx\n", width, height, channels, band_rows,
+                    (unsigned long long)job);
+        }
+    }
+
+    bool ok = file != NULL && journal != NULL;
+    // a line cut short by the interruption must not swallow the next one
+    if (ok && resuming) ok = fputc('\n', journal) != EOF;
+
+    for (size_t band = 0; ok && band < n_bands; ++band) {
+        if (done[band]) continue;
+
+        struct shard shard = {0, 1, band * band_rows, (band + 1) * band_rows < height ? (band + 1) * band_rows : height,
+                              0, 0};
+        set_window(&shard, height, sdf_reach(params));
+        size_t n_rows = shard.y1 - shard.y0;
+        ok = generate_rows(&shard, mask + shard.window_y0 * width, width, height, params, band_bytes) &&
+             seek_to(file, sizeof(header) + (uint64_t)shard.y0 * row_size) &&
+             fwrite(band_bytes, row_size, n_rows, file) == n_rows && fflush(file) == 0;
+
+        // a band is journaled only once its rows have left the process
+        if (ok) {
+            unsigned long long sum = checksum(band_bytes, n_rows * row_size);
+            ok = fprintf(journal, "band %zu %016llx\n", band, sum) > 0 && fflush(journal) == 0;
+        }
+    }
+
+    if (file != NULL) ok = fclose(file) == 0 && ok;
+    if (journal != NULL) ok = fclose(journal) == 0 && ok;
+    free(band_bytes);
+    free(done);
+    return ok;
+}
+
+bool shard_merge(const char* pattern, const char* filename, enum FILETYPE filetype, int quality) {
+    // a single shard, such as a tiled file, needs no index
+    int n_numbers = filename_pattern_numbers(pattern);
+    if (n_numbers < 0 || n_numbers > 1) {
+        fputs("Shard names need one index conversion such as %d, or none for a single shard.\n", stderr);
+        return false;
+    }
+
+    struct shard_header first;
+    memset(&first, 0, sizeof(first));
+    unsigned char* img = NULL;
+    size_t next_row = 0;
+    bool ok = true;
+
+    // the first shard tells the size of the image and the number of shards
+    for (size_t index = 0; ok && (index == 0 || index < first.count); ++index) {
+        char path[4096];
+        snprintf(path, sizeof(path), pattern, (int)index);
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "Shard \"%s\" could not be opened.\n", path);
+            ok = false;
+            break;
+        }
+
+        struct shard_header header;
+        ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, SHARD_MAGIC, 8) == 0;
+        if (ok && index == 0) {
+            first = header;
+            ok = first.count > 0 && first.channels > 0 &&
+                 (img = malloc((size_t)first.width * first.height * first.channels)) != NULL;
+        }
+        // shards have to be of the same image and cover its rows in order
+        ok = ok && header.width == first.width && header.height == first.height &&
+             header.channels == first.channels && header.count == first.count && header.index == index &&
+             header.y0 == next_row && header.y1 >= header.y0 && header.y1 <= first.height;
+        if (ok) {
+            size_t row_size = (size_t)first.width * first.channels;
+            size_t n_rows = header.y1 - header.y0;
+            ok = fread(img + header.y0 * row_size, row_size, n_rows, file) == n_rows;
+            next_row = header.y1;
+        }
+        if (!ok) fprintf(stderr, "Shard \"%s\" is invalid or does not match the first shard.\n", path);
+        fclose(file);
+    }
+
+    if (ok && next_row != first.height) {
+        fputs("Shards do not cover the whole image.\n", stderr);
+        ok = false;
+    }
+    if (ok) {
+        ok = write_image(filename, filetype, (int)first.width, (int)first.height, (int)first.channels, img, quality);
+        if (!ok) fputs("Merged image could not be written.\n", stderr);
+    }
+
+    free(img);
+    return ok;
+}
@@ -0,0 +1,56 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+#include "sdf.h"
+
+// A shard file is this header followed by rows y0 to y1 of the result, width pixels of channels bytes each, in the
+// byte order of the host that wrote it
+
+#define SHARD_MAGIC "chaqshd"
+
+struct shard_header {
+    // SHARD_MAGIC including its terminator
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t index;
+    uint32_t count;
+    uint32_t y0;
+    uint32_t y1;
+};
+
+// rows [y0,y1) of shard index of count, and the window [window_y0,window_y1) of mask rows they depend on
+struct shard {
+    size_t index;
+    size_t count;
+    size_t y0;
+    size_t y1;
+    size_t window_y0;
+    size_t window_y1;
+};
+
+// splits height rows into count bands, each needing the mask within reach above and below
+struct shard shard_plan(size_t index, size_t count, size_t height, size_t reach);
+
+// generates the rows of shard from the mask rows of its window and writes them to filename, "-" for stdout
+bool shard_generate(const struct shard* shard, const bool* window_mask, size_t width, size_t height,
+                    const struct sdf_params* params, const char* filename);
+
+// generates the whole image band by band of band_rows rows into a preallocated raw file laid out as a single shard,
+// recording every finished band with a checksum in a journal named filename.journal
+// with resume, journaled bands whose checksum still matches are kept and only the others are generated, and a journal
+// of another mask or other parameters fails the run
+bool shard_generate_tiled(const bool* mask, size_t width, size_t height, size_t band_rows,
+                          const struct sdf_params* params, const char* filename, bool resume);
+
+// assembles the shards named by pattern (with one integer conversion for the index, or none for a single shard) into an
+// image
+bool shard_merge(const char* pattern, const char* filename, enum FILETYPE filetype, int quality);
+
+#endif
@@ -0,0 +1,114 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "shm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+bool shm_output_requested(const char* filename) {
+    return strncmp(filename, "shm:", 4) == 0 || strncmp(filename, "memfd:", 6) == 0;
+}
+
+#ifndef _WIN32
+
+unsigned char* shm_output_open(const char* filename, size_t w, size_t h, size_t channels, struct shm_output* out) {
+    out->memfd = strncmp(filename, "memfd:", 6) == 0;
+    out->size = SHM_HEADER_SIZE + w * h * channels;
+
+    if (out->memfd) {
+#ifdef __linux__
+        out->fd = memfd_create(filename[6] ? filename + 6 : "chaq_sdfgen", MFD_CLOEXEC);
+#else
+        fputs("memfd output is only available on Linux.\n", stderr);
+        return NULL;
+#endif
+    } else {
+        out->fd = shm_open(filename + 4, O_CREAT | O_TRUNC | O_RDWR, 0600);
+    }
+    if (out->fd < 0) {
+        fprintf(stderr, "Shared memory \"%s\" could not be created: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(out->fd, (off_t)out->size) != 0 ||
+        (out->map = mmap(NULL, out->size, PROT_READ | PROT_WRITE, MAP_SHARED, out->fd, 0)) == MAP_FAILED) {
+        fprintf(stderr, "Shared memory \"%s\" could not be mapped: %s\n", filename, strerror(errno));
+        close(out->fd);
+        if (!out->memfd) shm_unlink(filename + 4);
+        return NULL;
+    }
+
+    struct shm_header header = {SHM_MAGIC, SHM_HEADER_SIZE, (uint32_t)w, (uint32_t)h, (uint32_t)channels};
+    memcpy(out->map, &header, sizeof(header));
+    return (unsigned char*)out->map + SHM_HEADER_SIZE;
+}
+
+bool shm_output_finish(struct shm_output* out) {
+    struct shm_header header;
+    memcpy(&header, out->map, sizeof(header));
+    munmap(out->map, out->size);
+
+    bool ok = true;
+    if (out->memfd) {
+        // the header travels as the message, the descriptor as ancillary data
+        struct iovec iov = {&header, sizeof(header)};
+        union {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &out->fd, sizeof(int));
+
+        if (sendmsg(STDOUT_FILENO, &msg, 0) < 0) {
+            fprintf(stderr, "memfd could not be sent, stdout must be a unix socket: %s\n", strerror(errno));
+            ok = false;
+        }
+    }
+
+    close(out->fd);
+    return ok;
+}
+
+#else
+
+unsigned char* shm_output_open(const char* filename, size_t w, size_t h, size_t channels, struct shm_output* out) {
+    (void)w;
+    (void)h;
+    (void)channels;
+    (void)out;
+    fprintf(stderr, "Shared memory output \"%s\" is not available on this platform.\n", filename);
+    return NULL;
+}
+
+bool shm_output_finish(struct shm_output* out) {
+    (void)out;
+    return false;
+}
+
+#endif
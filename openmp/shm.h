@@ -0,0 +1,43 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Layout of a shared memory result, for consumers mapping it:
+// the header at offset 0, followed at header_size by height rows of width pixels, channels bytes each, unpadded
+
+#define SHM_MAGIC "chaqsdf"
+#define SHM_HEADER_SIZE 64
+
+struct shm_header {
+    // SHM_MAGIC including its terminator
+    char magic[8];
+    // offset of the pixel data from the start of the segment
+    uint32_t header_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+};
+
+// A segment being written
+// shm:/name -- POSIX shared memory object, left for the consumer to shm_unlink
+// memfd:label -- anonymous memory file (Linux), whose descriptor is sent over stdout, which must be a unix socket
+struct shm_output {
+    void* map;
+    size_t size;
+    int fd;
+    bool memfd;
+};
+
+// whether filename names a shared memory output
+bool shm_output_requested(const char* filename);
+
+// creates and maps a segment for the result, returns where its pixels go or NULL after reporting on stderr
+unsigned char* shm_output_open(const char* filename, size_t w, size_t h, size_t channels, struct shm_output* out);
+
+// unmaps the segment and hands it over, sending the descriptor of a memfd along with a copy of the header
+bool shm_output_finish(struct shm_output* out);
+
+#endif
@@ -0,0 +1,154 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <omp.h>
+
+// spans per allocation of a thread's buffer
+#define TRACE_CHUNK_SPANS 4096
+
+struct trace_span {
+    const char* name;
+    double start;
+    double end;
+    long long index;
+};
+
+struct trace_chunk {
+    struct trace_span spans[TRACE_CHUNK_SPANS];
+    size_t n_spans;
+    struct trace_chunk* next;
+};
+
+// spans of one thread, only ever appended to by that thread
+struct trace_buffer {
+    int tid;
+    struct trace_chunk* first;
+    struct trace_chunk* last;
+    // next buffer of the list of all threads
+    struct trace_buffer* next;
+};
+
+atomic_bool trace_enabled = false;
+
+static double origin;
+// bumped by every trace_start, a thread whose buffer is from an earlier trace registers a new one, as trace_write
+// freed the old one
+static atomic_uint generation;
+// threads push their buffer on first use
+static _Atomic(struct trace_buffer*) buffers;
+static atomic_int n_threads;
+// spans lost to a failed allocation
+static atomic_size_t n_dropped;
+static _Thread_local struct trace_buffer* thread_buffer;
+static _Thread_local unsigned thread_generation;
+
+static struct trace_buffer* register_thread(void) {
+    struct trace_buffer* buffer = calloc(1, sizeof(struct trace_buffer));
+    if (buffer == NULL) return NULL;
+    buffer->tid = atomic_fetch_add(&n_threads, 1) + 1;
+    buffer->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer)) {
+    }
+    return buffer;
+}
+
+bool trace_start(void) {
+    origin = omp_get_wtime();
+    atomic_store(&buffers, NULL);
+    atomic_store(&n_threads, 0);
+    atomic_store(&n_dropped, 0);
+    thread_generation = atomic_fetch_add(&generation, 1) + 1;
+    // the starting thread comes first, as tid 1
+    thread_buffer = register_thread();
+    atomic_store_explicit(&trace_enabled, thread_buffer != NULL, memory_order_relaxed);
+    return thread_buffer != NULL;
+}
+
+bool trace_is_enabled(void) { return atomic_load_explicit(&trace_enabled, memory_order_relaxed); }
+
+double trace_clock(void) { return omp_get_wtime() - origin; }
+
+void trace_record(const char* name, double start, long long index) {
+    double end = trace_clock();
+    unsigned current = atomic_load_explicit(&generation, memory_order_relaxed);
+    if (thread_generation != current) {
+        thread_buffer = NULL;
+        thread_generation = current;
+    }
+    struct trace_buffer* buffer = thread_buffer;
+    if (buffer == NULL && (buffer = thread_buffer = register_thread()) == NULL) {
+        atomic_fetch_add_explicit(&n_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    struct trace_chunk* chunk = buffer->last;
+    if (chunk == NULL || chunk->n_spans == TRACE_CHUNK_SPANS) {
+        struct trace_chunk* grown = malloc(sizeof(struct trace_chunk));
+        if (grown == NULL) {
+            atomic_fetch_add_explicit(&n_dropped, 1, memory_order_relaxed);
+            return;
+        }
+        grown->n_spans = 0;
+        grown->next = NULL;
+        if (chunk != NULL) {
+            chunk->next = grown;
+        } else {
+            buffer->first = grown;
+        }
+        buffer->last = chunk = grown;
+    }
+    chunk->spans[chunk->n_spans++] = (struct trace_span){name, start, end, index};
+}
+
+bool trace_write(const char* filename) {
+    atomic_store_explicit(&trace_enabled, false, memory_order_relaxed);
+    FILE* file = fopen(filename, "w");
+    bool ok = file != NULL;
+
+    if (ok) fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first_event = true;
+    struct trace_buffer* buffer = atomic_load(&buffers);
+    while (buffer != NULL) {
+        if (ok) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,",
+                    first_event ? "" : ",\n", buffer->tid);
+            fprintf(file, "\"args\":{\"name\":\"%s %d\"}}", buffer->tid == 1 ? "main" : "thread", buffer->tid);
+            first_event = false;
+        }
+
+        struct trace_chunk* chunk = buffer->first;
+        while (chunk != NULL) {
+            for (size_t s = 0; ok && s < chunk->n_spans; ++s) {
+                const struct trace_span* span = &chunk->spans[s];
+                // timestamps in microseconds
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        span->name, buffer->tid, span->start * 1e6, (span->end - span->start) * 1e6);
+                if (span->index >= 0) fprintf(file, ",\"args\":{\"index\":%lld}", span->index);
+                fputc('}', file);
+            }
+            struct trace_chunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+
+        struct trace_buffer* next = buffer->next;
+        free(buffer);
+        buffer = next;
+    }
+    atomic_store(&buffers, NULL);
+    thread_buffer = NULL;
+
+    if (ok) {
+        fputs("\n]}\n", file);
+        ok = !ferror(file);
+    }
+    if (file != NULL) ok = fclose(file) == 0 && ok;
+
+    size_t dropped = atomic_load(&n_dropped);
+    if (dropped > 0) fprintf(stderr, "Trace is missing %zu spans that could not be stored.\n", dropped);
+    return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
+// Timeline of parallel regions, loop chunks and stages per thread, written as Chrome trace-event JSON (chrome://tracing
+// or Perfetto). Each thread appends to a buffer of its own, so recording takes no locks. The trace points are compiled
+// in unless CHAQ_NO_TRACE is defined, and until trace_start is called each costs a load and a branch (a call from C++).
+//
+//     TRACE_BEGIN(scope, "row");
+//     ...
+//     TRACE_END_INDEX(scope, y);
+
+#ifdef __cplusplus
+extern "C" {
+#else
+// set by trace_start, before any traced work, and read with relaxed loads
+extern atomic_bool trace_enabled;
+#endif
+
+// trace_enabled for C++, which cannot name a C atomic
+bool trace_is_enabled(void);
+
+// Starts recording, from the calling thread, returns false if out of memory. A trace may be started again once the
+// previous one is written.
+bool trace_start(void);
+
+// seconds on the trace's clock
+double trace_clock(void);
+
+// adds a span that started at start (trace_clock) and ends now, index is shown with it unless negative
+void trace_record(const char* name, double start, long long index);
+
+// Writes all spans recorded so far to filename and stops recording, call once the traced work is done
+bool trace_write(const char* filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#define TRACE_ENABLED() trace_is_enabled()
+#else
+#define TRACE_ENABLED() atomic_load_explicit(&trace_enabled, memory_order_relaxed)
+#endif
+
+#ifndef CHAQ_NO_TRACE
+// name must be a string literal or otherwise outlive the trace
+#define TRACE_BEGIN(scope, name) \
+    const char* scope##_name = (name); \
+    double scope##_start = TRACE_ENABLED() ? trace_clock() : 0.0
+#define TRACE_END_INDEX(scope, index) \
+    do { \
+        if (TRACE_ENABLED()) trace_record(scope##_name, scope##_start, (long long)(index)); \
+    } while (0)
+#else
+#define TRACE_BEGIN(scope, name) (void)0
+#define TRACE_END_INDEX(scope, index) (void)0
+#endif
+
+#define TRACE_END(scope) TRACE_END_INDEX(scope, -1)
+
+#endif
@@ -0,0 +1,446 @@
+#include "vector.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+// largest deviation of flattened curves from the true curve, in pixels
+#define FLATTEN_TOLERANCE (1.f / 32.f)
+#define FLATTEN_MAX_SEGMENTS 1024
+// side length of the tiles pixels are processed in, which are also the cells of the segment grid
+#define TILE_SIZE 32
+
+static bool add_segment(struct vector_outline* outline, float x0, float y0, float x1, float y1) {
+    if (x0 == x1 && y0 == y1) return true;
+    if (outline->n_segments == outline->capacity) {
+        size_t capacity = outline->capacity > 0 ? outline->capacity * 2 : 256;
+        float* grown = realloc(outline->segments, capacity * 4 * sizeof(float));
+        if (grown == NULL) return false;
+        outline->segments = grown;
+        outline->capacity = capacity;
+    }
+    float* s = outline->segments + outline->n_segments * 4;
+    s[0] = x0;
+    s[1] = y0;
+    s[2] = x1;
+    s[3] = y1;
+    ++outline->n_segments;
+    return true;
+}
+
+// flattens the cubic (or quadratic if p3 is NULL) bezier starting at p0
+static bool add_curve(struct vector_outline* outline, const float* p0, const float* p1, const float* p2,
+                      const float* p3) {
+    // chord error of n uniform steps is at most |B''| / (8 n^2)
+    float ddx0 = p0[0] - 2 * p1[0] + p2[0];
+    float ddy0 = p0[1] - 2 * p1[1] + p2[1];
+    float dd = sqrtf(ddx0 * ddx0 + ddy0 * ddy0) * 2.f;
+    if (p3 != NULL) {
+        float ddx1 = p1[0] - 2 * p2[0] + p3[0];
+        float ddy1 = p1[1] - 2 * p2[1] + p3[1];
+        float dd1 = sqrtf(ddx1 * ddx1 + ddy1 * ddy1);
+        dd = 6.f * (dd * 0.5f > dd1 ? dd * 0.5f : dd1);
+    }
+    float steps = ceilf(sqrtf(dd / (8.f * FLATTEN_TOLERANCE)));
+    size_t n = steps < 1.f ? 1 : (steps > FLATTEN_MAX_SEGMENTS ? FLATTEN_MAX_SEGMENTS : (size_t)steps);
+
+    float prev[2] = {p0[0], p0[1]};
+    for (size_t i = 1; i <= n; ++i) {
+        float t = (float)i / (float)n;
+        float u = 1.f - t;
+        float pt[2];
+        for (size_t c = 0; c < 2; ++c) {
+            pt[c] = p3 != NULL ? u * u * u * p0[c] + 3 * u * u * t * p1[c] + 3 * u * t * t * p2[c] + t * t * t * p3[c]
+                               : u * u * p0[c] + 2 * u * t * p1[c] + t * t * p2[c];
+        }
+        if (!add_segment(outline, prev[0], prev[1], pt[0], pt[1])) return false;
+        prev[0] = pt[0];
+        prev[1] = pt[1];
+    }
+    return true;
+}
+
+// reads the next number of path data, skipping separators
+static bool read_number(const char** cursor, float* value_out) {
+    const char* p = *cursor;
+    while (isspace((unsigned char)*p) || *p == ',') ++p;
+    char* end;
+    *value_out = strtof(p, &end);
+    if (end == p) return false;
+    *cursor = end;
+    return true;
+}
+
+// whether more numbers follow before the next command
+static bool numbers_follow(const char* p) {
+    while (isspace((unsigned char)*p) || *p == ',') ++p;
+    return *p == '-' || *p == '+' || *p == '.' || isdigit((unsigned char)*p);
+}
+
+static bool parse_path_data(const char* p, const char* end, float scale, struct vector_outline* outline) {
+    float cur[2] = {0.f, 0.f};
+    float start[2] = {0.f, 0.f};
+    bool open = false;
+    char command = '\0';
+
+    while (p < end) {
+        while (p < end && (isspace((unsigned char)*p) || *p == ',')) ++p;
+        if (p >= end) break;
+
+        // a bare list of coordinates is a polygon
+        if (isalpha((unsigned char)*p)) {
+            command = *p++;
+        } else if (command == '\0') {
+            command = 'M';
+        }
+        // numbers repeat the previous command, and a moveto continues as lineto
+        bool relative = islower((unsigned char)command);
+        float base[2] = {relative ? cur[0] : 0.f, relative ? cur[1] : 0.f};
+        float v[6];
+
+        switch (toupper((unsigned char)command)) {
+        case 'M': {
+            if (!read_number(&p, &v[0]) || !read_number(&p, &v[1])) goto malformed;
+            if (open && !add_segment(outline, cur[0], cur[1], start[0], start[1])) goto out_of_memory;
+            cur[0] = base[0] + v[0] * scale;
+            cur[1] = base[1] + v[1] * scale;
+            start[0] = cur[0];
+            start[1] = cur[1];
+            open = true;
+            command = relative ? 'l' : 'L';
+        } break;
+        case 'L':
+        case 'H':
+        case 'V': {
+            char c = (char)toupper((unsigned char)command);
+            float next[2] = {cur[0], cur[1]};
+            if (c == 'L') {
+                if (!read_number(&p, &v[0]) || !read_number(&p, &v[1])) goto malformed;
+                next[0] = base[0] + v[0] * scale;
+                next[1] = base[1] + v[1] * scale;
+            } else {
+                if (!read_number(&p, &v[0])) goto malformed;
+                size_t axis = c == 'H' ? 0 : 1;
+                next[axis] = base[axis] + v[0] * scale;
+            }
+            if (!add_segment(outline, cur[0], cur[1], next[0], next[1])) goto out_of_memory;
+            cur[0] = next[0];
+            cur[1] = next[1];
+        } break;
+        case 'Q':
+        case 'C': {
+            size_t n_points = toupper((unsigned char)command) == 'Q' ? 2 : 3;
+            float pts[3][2];
+            for (size_t i = 0; i < n_points; ++i) {
+                if (!read_number(&p, &v[0]) || !read_number(&p, &v[1])) goto malformed;
+                pts[i][0] = base[0] + v[0] * scale;
+                pts[i][1] = base[1] + v[1] * scale;
+            }
+            bool ok = n_points == 2 ? add_curve(outline, cur, pts[0], pts[1], NULL)
+                                    : add_curve(outline, cur, pts[0], pts[1], pts[2]);
+            if (!ok) goto out_of_memory;
+            cur[0] = pts[n_points - 1][0];
+            cur[1] = pts[n_points - 1][1];
+        } break;
+        case 'Z': {
+            if (open && !add_segment(outline, cur[0], cur[1], start[0], start[1])) goto out_of_memory;
+            cur[0] = start[0];
+            cur[1] = start[1];
+            open = false;
+            if (numbers_follow(p)) goto malformed;
+        } break;
+        default: {
+            fprintf(stderr, "Unsupported path command '%c'.\n", command);
+            return false;
+        }
+        }
+    }
+
+    // filling closes open subpaths
+    if (open && !add_segment(outline, cur[0], cur[1], start[0], start[1])) goto out_of_memory;
+    return true;
+
+malformed:
+    fprintf(stderr, "Malformed path data after command '%c'.\n", command);
+    return false;
+out_of_memory:
+    fputs("Out of memory while reading path data.\n", stderr);
+    return false;
+}
+
+bool vector_parse(const char* text, float scale, struct vector_outline* outline_out) {
+    struct vector_outline outline = {NULL, 0, 0};
+    bool ok = true;
+
+    if (strstr(text, "<path") == NULL) {
+        ok = parse_path_data(text, text + strlen(text), scale, &outline);
+    } else {
+        // d attributes of path elements
+        const char* element = text;
+        while (ok && (element = strstr(element, "<path")) != NULL) {
+            element += 5;
+            const char* close = strchr(element, '>');
+            const char* d = strstr(element, " d=");
+            if (d == NULL || (close != NULL && d > close)) continue;
+            char quote = d[3];
+            const char* begin = d + 4;
+            const char* end = strchr(begin, quote);
+            if ((quote != '"' && quote != '\'') || end == NULL) {
+                fputs("Malformed path element.\n", stderr);
+                ok = false;
+                break;
+            }
+            ok = parse_path_data(begin, end, scale, &outline);
+        }
+    }
+
+    if (ok && outline.n_segments == 0) {
+        fputs("Path data contains no segments.\n", stderr);
+        ok = false;
+    }
+    if (!ok) {
+        vector_free(&outline);
+        return false;
+    }
+    *outline_out = outline;
+    return true;
+}
+
+void vector_free(struct vector_outline* outline) {
+    free(outline->segments);
+    outline->segments = NULL;
+    outline->n_segments = 0;
+    outline->capacity = 0;
+}
+
+// squared distance from (px, py) to segment s
+static float segment_dist_2(const float* s, float px, float py) {
+    float ex = s[2] - s[0];
+    float ey = s[3] - s[1];
+    float wx = px - s[0];
+    float wy = py - s[1];
+    float t = (wx * ex + wy * ey) / (ex * ex + ey * ey);
+    t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+    float dx = wx - ex * t;
+    float dy = wy - ey * t;
+    return dx * dx + dy * dy;
+}
+
+// range of tiles covered by [lo, hi] along an axis of n_tiles tiles
+static void tile_range(float lo, float hi, size_t n_tiles, size_t* first, size_t* last) {
+    float f = floorf(lo / TILE_SIZE);
+    float l = floorf(hi / TILE_SIZE);
+    *first = f < 0.f ? 0 : (f >= (float)n_tiles ? n_tiles : (size_t)f);
+    *last = l < 0.f ? 0 : (l >= (float)n_tiles ? n_tiles - 1 : (size_t)l);
+}
+
+// bins segments into every tile within reach of their bounding box, as compressed rows (cell_start, cell_items)
+static bool build_grid(const struct vector_outline* outline, size_t tiles_x, size_t tiles_y, float reach,
+                       size_t** cell_start_out, size_t** cell_items_out) {
+    size_t n_cells = tiles_x * tiles_y;
+    size_t* cell_start = calloc(n_cells + 1, sizeof(size_t));
+    if (cell_start == NULL) return false;
+
+    // first pass counts, second pass fills
+    size_t* cell_items = NULL;
+    for (size_t pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < outline->n_segments; ++i) {
+            const float* s = outline->segments + i * 4;
+            size_t tx0, tx1, ty0, ty1;
+            tile_range(fminf(s[0], s[2]) - reach, fmaxf(s[0], s[2]) + reach, tiles_x, &tx0, &tx1);
+            tile_range(fminf(s[1], s[3]) - reach, fmaxf(s[1], s[3]) + reach, tiles_y, &ty0, &ty1);
+            if (tx0 >= tiles_x || ty0 >= tiles_y) continue;
+            for (size_t ty = ty0; ty <= ty1; ++ty) {
+                for (size_t tx = tx0; tx <= tx1; ++tx) {
+                    size_t cell = ty * tiles_x + tx;
+                    if (pass == 0) {
+                        ++cell_start[cell + 1];
+                    } else {
+                        cell_items[cell_start[cell]++] = i;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (size_t cell = 0; cell < n_cells; ++cell) cell_start[cell + 1] += cell_start[cell];
+            cell_items = malloc((cell_start[n_cells] > 0 ? cell_start[n_cells] : 1) * sizeof(size_t));
+            if (cell_items == NULL) {
+                free(cell_start);
+                return false;
+            }
+        } else {
+            // filling advanced every start to the next cell's start, shift back
+            for (size_t cell = n_cells; cell > 0; --cell) cell_start[cell] = cell_start[cell - 1];
+            cell_start[0] = 0;
+        }
+    }
+
+    *cell_start_out = cell_start;
+    *cell_items_out = cell_items;
+    return true;
+}
+
+// Bins segments into the rows whose pixel centers they may cross, as compressed rows (row_start, row_items). Returns
+// the most segments in one row through max_items_out.
+static bool build_edge_table(const struct vector_outline* outline, size_t h, size_t** row_start_out,
+                             size_t** row_items_out, size_t* max_items_out) {
+    size_t* row_start = calloc(h + 1, sizeof(size_t));
+    if (row_start == NULL) return false;
+
+    // first pass counts, second pass fills. The range is one row wider on each side than the crossings, which
+    // row_signs tests exactly.
+    size_t* row_items = NULL;
+    for (size_t pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < outline->n_segments; ++i) {
+            const float* s = outline->segments + i * 4;
+            float lo = floorf(fminf(s[1], s[3])) - 1.f;
+            float hi = ceilf(fmaxf(s[1], s[3]));
+            if (hi < 0.f || lo >= (float)h) continue;
+            size_t y0 = lo < 0.f ? 0 : (size_t)lo;
+            size_t y1 = hi >= (float)h ? h - 1 : (size_t)hi;
+            for (size_t y = y0; y <= y1; ++y) {
+                if (pass == 0) {
+                    ++row_start[y + 1];
+                } else {
+                    row_items[row_start[y]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            size_t max_items = 0;
+            for (size_t y = 0; y < h; ++y) {
+                max_items = row_start[y + 1] > max_items ? row_start[y + 1] : max_items;
+                row_start[y + 1] += row_start[y];
+            }
+            *max_items_out = max_items;
+            row_items = malloc((row_start[h] > 0 ? row_start[h] : 1) * sizeof(size_t));
+            if (row_items == NULL) {
+                free(row_start);
+                return false;
+            }
+        } else {
+            // filling advanced every start to the next row's start, shift back
+            for (size_t y = h; y > 0; --y) row_start[y] = row_start[y - 1];
+            row_start[0] = 0;
+        }
+    }
+
+    *row_start_out = row_start;
+    *row_items_out = row_items;
+    return true;
+}
+
+struct crossing {
+    float x;
+    int winding;
+};
+
+static int compare_crossings(const void* a, const void* b) {
+    float xa = ((const struct crossing*)a)->x;
+    float xb = ((const struct crossing*)b)->x;
+    return (xa > xb) - (xa < xb);
+}
+
+// nonzero winding of the pixel centers of row y, written as +-1 into sign_out, from the n_items segments of the row
+static void row_signs(const struct vector_outline* outline, const size_t* items, size_t n_items, size_t w, size_t y,
+                      struct crossing* crossings, float* sign_out) {
+    float py = (float)y + 0.5f;
+    size_t n = 0;
+    for (size_t i = 0; i < n_items; ++i) {
+        const float* s = outline->segments + items[i] * 4;
+        // half open so shared endpoints are counted once
+        bool up = s[1] <= py && s[3] > py;
+        bool down = s[3] <= py && s[1] > py;
+        if (!up && !down) continue;
+        float t = (py - s[1]) / (s[3] - s[1]);
+        crossings[n].x = s[0] + t * (s[2] - s[0]);
+        crossings[n].winding = up ? 1 : -1;
+        ++n;
+    }
+    qsort(crossings, n, sizeof(struct crossing), compare_crossings);
+
+    int winding = 0;
+    size_t next = 0;
+    for (size_t x = 0; x < w; ++x) {
+        float px = (float)x + 0.5f;
+        while (next < n && crossings[next].x <= px) winding += crossings[next++].winding;
+        sign_out[x] = winding != 0 ? 1.f : -1.f;
+    }
+}
+
+bool vector_distance_field(const struct vector_outline* outline, size_t w, size_t h, float reach, float* field_out) {
+    size_t tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+    size_t tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+    size_t* cell_start;
+    size_t* cell_items;
+    if (!build_grid(outline, tiles_x, tiles_y, reach, &cell_start, &cell_items)) return false;
+    size_t* row_start;
+    size_t* row_items;
+    size_t max_items;
+    if (!build_edge_table(outline, h, &row_start, &row_items, &max_items)) {
+        free(cell_items);
+        free(cell_start);
+        return false;
+    }
+
+    // signs first, distances are multiplied in per tile. Each thread's scratch is allocated up front so that a failed
+    // allocation stops the whole field before any row is computed.
+    int n_threads = omp_get_max_threads();
+    size_t scratch = max_items > 0 ? max_items : 1;
+    struct crossing* crossings = malloc((size_t)n_threads * scratch * sizeof(struct crossing));
+    if (crossings == NULL) {
+        free(row_items);
+        free(row_start);
+        free(cell_items);
+        free(cell_start);
+        return false;
+    }
+
+#pragma omp parallel num_threads(n_threads)
+    {
+        size_t thread = (size_t)omp_get_thread_num();
+        ptrdiff_t y;
+#pragma omp for schedule(static)
+        for (y = 0; y < (ptrdiff_t)(h); ++y) {
+            row_signs(outline, row_items + row_start[y], row_start[y + 1] - row_start[y], w, (size_t)y,
+                      crossings + thread * scratch, field_out + (size_t)y * w);
+        }
+    }
+    free(crossings);
+    free(row_items);
+    free(row_start);
+
+    ptrdiff_t tile;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (tile = 0; tile < (ptrdiff_t)(tiles_x * tiles_y); ++tile) {
+        size_t tx = (size_t)tile % tiles_x;
+        size_t ty = (size_t)tile / tiles_x;
+        const size_t* items = cell_items + cell_start[tile];
+        size_t n_items = cell_start[tile + 1] - cell_start[tile];
+
+        size_t x_end = (tx + 1) * TILE_SIZE < w ? (tx + 1) * TILE_SIZE : w;
+        size_t y_end = (ty + 1) * TILE_SIZE < h ? (ty + 1) * TILE_SIZE : h;
+        for (size_t y = ty * TILE_SIZE; y < y_end; ++y) {
+            for (size_t x = tx * TILE_SIZE; x < x_end; ++x) {
+                float px = (float)x + 0.5f;
+                float py = (float)y + 0.5f;
+                float best = reach * reach;
+                for (size_t i = 0; i < n_items; ++i) {
+                    float d_2 = segment_dist_2(outline->segments + items[i] * 4, px, py);
+                    best = d_2 < best ? d_2 : best;
+                }
+                field_out[y * w + x] *= sqrtf(best);
+            }
+        }
+    }
+
+    free(cell_items);
+    free(cell_start);
+    return true;
+}
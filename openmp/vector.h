@@ -0,0 +1,27 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// outline as line segments, 4 floats (x0, y0, x1, y1) each, in pixels
+struct vector_outline {
+    float* segments;
+    size_t n_segments;
+    size_t capacity;
+};
+
+// parses SVG path data (M, L, H, V, Q, C and Z, absolute and relative) or a bare list of polygon coordinates
+// the d attributes of all path elements are used if text contains any, every subpath is closed
+// curves are flattened to within 1/32 pixel, coordinates are multiplied by scale
+// returns false and reports on stderr if text is malformed
+bool vector_parse(const char* text, float scale, struct vector_outline* outline_out);
+
+void vector_free(struct vector_outline* outline);
+
+// signed distance from each pixel center to the outline, positive inside under the nonzero fill rule
+// distances beyond reach are clamped to +-reach, returns false if the segment grid could not be allocated
+// field_out -- w*h floats
+bool vector_distance_field(const struct vector_outline* outline, size_t w, size_t h, float reach, float* field_out);
+
+#endif